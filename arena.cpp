@@ -0,0 +1,103 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+using namespace std;
+
+Arena::Arena(size_t blockSize2) : blockSize(blockSize2), used(0),
+	allocated(0) {
+	
+}
+
+Arena::~Arena() {
+	for(size_t i = 0; i < blocks.size(); i++) {
+		free(blocks[i]);
+	}
+}
+
+void Arena::addBlock(size_t size) {
+	void* p = NULL;
+	if (posix_memalign(&p, DEFAULT_ALIGNMENT, size) != 0) {
+		assert(!"Out of memory");
+	}
+	blocks.push_back((char*)p);
+	blockSizes.push_back(size);
+	used = 0;
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+	if (!blocks.empty()) {
+		size_t start = (used + alignment - 1) & ~(alignment - 1);
+		if (alignment <= DEFAULT_ALIGNMENT && start + bytes <= blockSizes.back()) {
+			used = start + bytes;
+			allocated += bytes;
+			return blocks.back() + start;
+		}
+	}
+
+	//Blocks start DEFAULT_ALIGNMENT-aligned, so only larger alignments need
+	//room to be made up
+	size_t extra = alignment > DEFAULT_ALIGNMENT ? alignment : 0;
+	addBlock(bytes + extra > blockSize ? bytes + extra : blockSize);
+	size_t start = ((size_t)blocks.back() + alignment - 1) & ~(alignment - 1);
+	used = start - (size_t)blocks.back() + bytes;
+	allocated += bytes;
+	return (char*)start;
+}
+
+void Arena::reset() {
+	size_t largest = 0;
+	for(size_t i = 1; i < blocks.size(); i++) {
+		if (blockSizes[i] > blockSizes[largest]) {
+			largest = i;
+		}
+	}
+	for(size_t i = 0; i < blocks.size(); i++) {
+		if (i != largest) {
+			free(blocks[i]);
+		}
+	}
+	if (!blocks.empty()) {
+		char* block = blocks[largest];
+		size_t size = blockSizes[largest];
+		blocks.assign(1, block);
+		blockSizes.assign(1, size);
+	}
+	used = 0;
+	allocated = 0;
+}
+
+
+
+
+
+
+
+
+
+
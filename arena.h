@@ -0,0 +1,82 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef ARENA_H_INCLUDED
+#define ARENA_H_INCLUDED
+
+#include <stddef.h>
+
+#include <vector>
+
+/* A bump allocator.  Allocations are carved one after another out of large
+ * blocks, and are never freed one at a time: resetting or destroying the arena
+ * frees them all at once, however many there were.  An arena must only be
+ * used by one thread at a time.
+ */
+class Arena {
+	private:
+		//The blocks of memory, the last of which allocations come from
+		std::vector<char*> blocks;
+		std::vector<size_t> blockSizes;
+		size_t blockSize; //The size of new blocks, unless more is needed
+		size_t used; //The bytes used in the last block
+		size_t allocated; //The bytes handed out since the last reset
+
+		Arena(const Arena &other);
+		void operator=(const Arena &other);
+
+		void addBlock(size_t size);
+	public:
+		//The alignment allocations get by default, in bytes
+		static const size_t DEFAULT_ALIGNMENT = 64;
+
+		//Makes an arena that takes memory from the system in blocks of
+		//blockSize2 bytes, or larger ones for larger allocations
+		explicit Arena(size_t blockSize2 = 1 << 20);
+		~Arena();
+
+		//Returns bytes bytes of uninitialized memory, aligned to alignment,
+		//which must be a power of two
+		void* allocate(size_t bytes, size_t alignment = DEFAULT_ALIGNMENT);
+
+		//Frees everything allocated so far.  The largest block is kept for
+		//later allocations.
+		void reset();
+
+		//Returns the number of bytes allocated since the last reset
+		size_t bytesAllocated() {
+			return allocated;
+		}
+};
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,201 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+
+#include <fstream>
+#include <vector>
+
+#include "heightmaps.h"
+
+using namespace std;
+
+namespace {
+	Terrain* makeTerrain(int w, int l, float height, ThreadPool* pool,
+						 NormalFormat normalFormat, HeightFormat heightFormat,
+						 TerrainLayout layout, Arena* arena) {
+		Terrain* t;
+		if (heightFormat == HEIGHTS_UINT16) {
+			t = new Terrain(w, l, -height / 2, height / 2, normalFormat,
+							layout, arena);
+		}
+		else {
+			t = new Terrain(w, l, normalFormat, layout, arena);
+		}
+		t->setThreadPool(pool);
+		return t;
+	}
+
+	//Reads the l rows of w samples that follow in input into t, where each
+	//sample is bytesPerSample bytes, in the given byte order, and maxValue
+	//is the highest height.  Returns false if the file ends too soon.
+	bool readRows(ifstream &input, Terrain* t, int bytesPerSample,
+				  bool bigEndian, int maxValue, float height) {
+		int w = t->width();
+		int l = t->length();
+		vector<unsigned char> bytes((size_t)w * bytesPerSample);
+		vector<float> row(w);
+		float scale = height / maxValue;
+		for(int i = 0; i < l; i++) {
+			input.read((char*)&bytes[0], bytes.size());
+			if (input.fail()) {
+				return false;
+			}
+			if (bytesPerSample == 1) {
+				for(int x = 0; x < w; x++) {
+					row[x] = bytes[x] * scale - height / 2;
+				}
+			}
+			else {
+				int high = bigEndian ? 0 : 1;
+				for(int x = 0; x < w; x++) {
+					int value = (bytes[2 * x + high] << 8) |
+						bytes[2 * x + 1 - high];
+					row[x] = value * scale - height / 2;
+				}
+			}
+			t->writeHeights(l - 1 - i, 0, w, &row[0]);
+		}
+		return true;
+	}
+
+	//Skips whitespace and comments in the header of a PGM file
+	void skipPGMSpace(ifstream &input) {
+		while (true) {
+			int c = input.peek();
+			if (c == '#') {
+				while (c != '\n' && c != EOF) {
+					c = input.get();
+				}
+			}
+			else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+				input.get();
+			}
+			else {
+				return;
+			}
+		}
+	}
+
+	//Reads a number in the header of a PGM file, or returns -1
+	int readPGMNumber(ifstream &input) {
+		skipPGMSpace(input);
+		int value = -1;
+		input >> value;
+		return input.fail() ? -1 : value;
+	}
+}
+
+bool hasExtension(const char* filename, const char* extension) {
+	size_t length = strlen(filename);
+	size_t extensionLength = strlen(extension);
+	return length > extensionLength &&
+		strcasecmp(filename + length - extensionLength, extension) == 0;
+}
+
+Terrain* loadTerrainPGM(const char* filename, float height, ThreadPool* pool,
+						NormalFormat normalFormat, HeightFormat heightFormat,
+						TerrainLayout layout, Arena* arena) {
+	ifstream input;
+	input.open(filename, ifstream::binary);
+	assert(!input.fail() || !"Could not find file");
+	char magic[2];
+	input.read(magic, 2);
+	if (input.fail() || magic[0] != 'P' || magic[1] != '5') {
+		return NULL;
+	}
+	int w = readPGMNumber(input);
+	int l = readPGMNumber(input);
+	int maxValue = readPGMNumber(input);
+	if (w <= 0 || l <= 0 || maxValue <= 0 || maxValue > 65535) {
+		return NULL;
+	}
+	//A single whitespace character separates the header from the pixels
+	input.get();
+
+	Terrain* t = makeTerrain(w, l, height, pool, normalFormat, heightFormat,
+							 layout, arena);
+	if (!readRows(input, t, maxValue < 256 ? 1 : 2, true, maxValue, height)) {
+		delete t;
+		return NULL;
+	}
+	t->computeNormals();
+	return t;
+}
+
+Terrain* loadTerrainRaw(const char* filename, int w, int l, float height,
+						ThreadPool* pool, NormalFormat normalFormat,
+						HeightFormat heightFormat, TerrainLayout layout,
+						Arena* arena) {
+	ifstream input;
+	input.open(filename, ifstream::binary);
+	assert(!input.fail() || !"Could not find file");
+	input.seekg(0, ios_base::end);
+	long long size = (long long)input.tellg();
+	input.seekg(0, ios_base::beg);
+
+	if (w == 0 && l == 0) {
+		w = l = (int)floor(sqrt(size / 2.0) + 0.5);
+	}
+	if (w <= 0 || l <= 0 || size != 2LL * w * l) {
+		return NULL;
+	}
+
+	Terrain* t = makeTerrain(w, l, height, pool, normalFormat, heightFormat,
+							 layout, arena);
+	if (!readRows(input, t, 2, false, 65535, height)) {
+		delete t;
+		return NULL;
+	}
+	t->computeNormals();
+	return t;
+}
+
+Terrain* loadHeightmap(const char* filename, float height, ThreadPool* pool,
+					   NormalFormat normalFormat, HeightFormat heightFormat,
+					   TerrainLayout layout, Arena* arena) {
+	if (hasExtension(filename, ".pgm")) {
+		return loadTerrainPGM(filename, height, pool, normalFormat,
+							  heightFormat, layout, arena);
+	}
+	if (hasExtension(filename, ".raw")) {
+		return loadTerrainRaw(filename, 0, 0, height, pool, normalFormat,
+							  heightFormat, layout, arena);
+	}
+	return loadTerrain(filename, height, pool, normalFormat, heightFormat,
+					   layout, arena);
+}
+
+
+
+
+
+
+
+
+
+
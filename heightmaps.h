@@ -0,0 +1,79 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef HEIGHTMAPS_H_INCLUDED
+#define HEIGHTMAPS_H_INCLUDED
+
+#include "terrain.h"
+
+class ThreadPool;
+
+/* Loaders for single-channel heightmaps, which keep up to 16 bits per height.
+ * They read a row at a time straight into the terrain, without holding the
+ * whole image in memory.  As with loadTerrain, the heights go from
+ * -height / 2 to height / 2, the first row of the file is the top of the
+ * image, at z = length - 1, and if arena isn't NULL, the terrain's buffers are
+ * allocated from it.
+ */
+
+//Loads a binary (P5) PGM image with up to 16 bits per pixel.  Returns NULL
+//if the file isn't one.
+Terrain* loadTerrainPGM(const char* filename, float height,
+						ThreadPool* pool = NULL,
+						NormalFormat normalFormat = NORMALS_FLOAT,
+						HeightFormat heightFormat = HEIGHTS_FLOAT,
+						TerrainLayout layout = LAYOUT_ROWS,
+						Arena* arena = NULL);
+
+//Loads a headerless file of w x l little-endian 16-bit heights.  If w and l
+//are 0, the file is taken to be square.  Returns NULL if the file is the
+//wrong size.
+Terrain* loadTerrainRaw(const char* filename, int w, int l, float height,
+						ThreadPool* pool = NULL,
+						NormalFormat normalFormat = NORMALS_FLOAT,
+						HeightFormat heightFormat = HEIGHTS_FLOAT,
+						TerrainLayout layout = LAYOUT_ROWS,
+						Arena* arena = NULL);
+
+//Returns whether filename ends with extension, such as ".pgm", ignoring case
+bool hasExtension(const char* filename, const char* extension);
+
+//Loads a .pgm, square .raw or .bmp heightmap, going by the file's extension
+Terrain* loadHeightmap(const char* filename, float height,
+					   ThreadPool* pool = NULL,
+					   NormalFormat normalFormat = NORMALS_FLOAT,
+					   HeightFormat heightFormat = HEIGHTS_FLOAT,
+					   TerrainLayout layout = LAYOUT_ROWS,
+					   Arena* arena = NULL);
+
+
+
+
+
+
+
+
+
+
+#endif
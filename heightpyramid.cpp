@@ -0,0 +1,278 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include "heightpyramid.h"
+#include "terrain.h"
+
+using namespace std;
+
+namespace {
+	//Finds where the ray origin + t * dir meets the triangle (a, b, c), using
+	//the Moller-Trumbore test.  Returns whether it does, and if so sets t.
+	bool rayTriangle(const Vec3f &origin, const Vec3f &dir, const Vec3f &a,
+					 const Vec3f &b, const Vec3f &c, float &t) {
+		const float EPSILON = 1e-7f;
+		Vec3f e1 = b - a;
+		Vec3f e2 = c - a;
+		Vec3f p = dir.cross(e2);
+		float det = e1.dot(p);
+		if (fabsf(det) < EPSILON) {
+			return false;
+		}
+		float invDet = 1.0f / det;
+		Vec3f s = origin - a;
+		float u = s.dot(p) * invDet;
+		if (u < 0.0f || u > 1.0f) {
+			return false;
+		}
+		Vec3f q = s.cross(e1);
+		float v = dir.dot(q) * invDet;
+		if (v < 0.0f || u + v > 1.0f) {
+			return false;
+		}
+		t = e2.dot(q) * invDet;
+		return true;
+	}
+
+	//Narrows [tMin, tMax] to the part of the ray o + t * d with lo <= o + t * d
+	//<= hi along one axis.  Returns whether any of it is left.
+	bool clipSlab(float o, float d, float lo, float hi,
+				  float &tMin, float &tMax) {
+		if (d == 0.0f) {
+			return o >= lo && o <= hi;
+		}
+		float t0 = (lo - o) / d;
+		float t1 = (hi - o) / d;
+		if (t0 > t1) {
+			swap(t0, t1);
+		}
+		tMin = max(tMin, t0);
+		tMax = min(tMax, t1);
+		return tMin <= tMax;
+	}
+}
+
+HeightPyramid::HeightPyramid(Terrain* terrain) {
+	int cellsX = max(terrain->width() - 1, 0);
+	int cellsZ = max(terrain->length() - 1, 0);
+	int lw = cellsX;
+	int ll = cellsZ;
+	while (true) {
+		levelWidths.push_back(lw);
+		levelLengths.push_back(ll);
+		levels.push_back(vector<float>(2 * lw * ll));
+		if (lw <= 1 && ll <= 1) {
+			break;
+		}
+		lw = (lw + 1) / 2;
+		ll = (ll + 1) / 2;
+	}
+
+	update(terrain, terrain->bounds());
+}
+
+void HeightPyramid::updateCells(Terrain* terrain, int cx0, int cz0,
+								int cx1, int cz1) {
+	vector<float> row(cx1 - cx0 + 1);
+	vector<float> nextRow(cx1 - cx0 + 1);
+	vector<float> &level = levels[0];
+	int lw = levelWidths[0];
+
+	terrain->readHeights(cz0, cx0, cx1 + 1, &row[0]);
+	for(int z = cz0; z < cz1; z++) {
+		terrain->readHeights(z + 1, cx0, cx1 + 1, &nextRow[0]);
+		for(int x = cx0; x < cx1; x++) {
+			int i = x - cx0;
+			float lo = min(min(row[i], row[i + 1]),
+						   min(nextRow[i], nextRow[i + 1]));
+			float hi = max(max(row[i], row[i + 1]),
+						   max(nextRow[i], nextRow[i + 1]));
+			level[2 * (z * lw + x)] = lo;
+			level[2 * (z * lw + x) + 1] = hi;
+		}
+		row.swap(nextRow);
+	}
+}
+
+void HeightPyramid::update(Terrain* terrain, const TerrainRect &rect) {
+	if (rect.isEmpty() || levelWidths[0] == 0 || levelLengths[0] == 0) {
+		return;
+	}
+
+	//A height is a corner of the cells up and to the left of it
+	int x0 = max(rect.x0 - 1, 0);
+	int z0 = max(rect.z0 - 1, 0);
+	int x1 = min(rect.x1, levelWidths[0]);
+	int z1 = min(rect.z1, levelLengths[0]);
+	if (x0 >= x1 || z0 >= z1) {
+		return;
+	}
+	updateCells(terrain, x0, z0, x1, z1);
+
+	for(size_t k = 1; k < levels.size(); k++) {
+		x0 /= 2;
+		z0 /= 2;
+		x1 = (x1 + 1) / 2;
+		z1 = (z1 + 1) / 2;
+
+		const vector<float> &child = levels[k - 1];
+		int cw = levelWidths[k - 1];
+		int cl = levelLengths[k - 1];
+		vector<float> &level = levels[k];
+		int lw = levelWidths[k];
+		for(int z = z0; z < z1; z++) {
+			for(int x = x0; x < x1; x++) {
+				float lo = FLT_MAX;
+				float hi = -FLT_MAX;
+				for(int cz = 2 * z; cz < min(2 * z + 2, cl); cz++) {
+					for(int cx = 2 * x; cx < min(2 * x + 2, cw); cx++) {
+						lo = min(lo, child[2 * (cz * cw + cx)]);
+						hi = max(hi, child[2 * (cz * cw + cx) + 1]);
+					}
+				}
+				level[2 * (z * lw + x)] = lo;
+				level[2 * (z * lw + x) + 1] = hi;
+			}
+		}
+	}
+}
+
+float HeightPyramid::minHeight() const {
+	return levels.back().empty() ? 0.0f : levels.back()[0];
+}
+
+float HeightPyramid::maxHeight() const {
+	return levels.back().empty() ? 0.0f : levels.back()[1];
+}
+
+bool HeightPyramid::raycast(Terrain* terrain, const Vec3f &origin,
+							const Vec3f &dir, float maxT, float &t) const {
+	int cellsX = levelWidths[0];
+	int cellsZ = levelLengths[0];
+	if (cellsX == 0 || cellsZ == 0) {
+		return false;
+	}
+
+	//Only the part of the ray inside the terrain's bounding box matters
+	float tMin = 0.0f;
+	float tMax = maxT;
+	if (!clipSlab(origin[0], dir[0], 0.0f, (float)cellsX, tMin, tMax) ||
+		!clipSlab(origin[2], dir[2], 0.0f, (float)cellsZ, tMin, tMax) ||
+		!clipSlab(origin[1], dir[1], minHeight(), maxHeight(), tMin, tMax)) {
+		return false;
+	}
+
+	//How far to step t past the edge of a node to land in the next one
+	float horizontal = max(fabsf(dir[0]), fabsf(dir[2]));
+	float nudge = horizontal > 0.0f ? 1e-3f / horizontal : 0.0f;
+
+	int top = (int)levels.size() - 1;
+	int k = top;
+	float tNode = tMin;
+	while (tNode <= tMax) {
+		int cx = (int)floorf(origin[0] + dir[0] * tNode);
+		int cz = (int)floorf(origin[2] + dir[2] * tNode);
+		cx = min(max(cx, 0), cellsX - 1);
+		cz = min(max(cz, 0), cellsZ - 1);
+
+		//The node of level k under the ray, and where the ray leaves it
+		int nx = cx >> k;
+		int nz = cz >> k;
+		float x0 = (float)(nx << k);
+		float z0 = (float)(nz << k);
+		float x1 = (float)min((nx + 1) << k, cellsX);
+		float z1 = (float)min((nz + 1) << k, cellsZ);
+		float tExit = tMax;
+		if (dir[0] > 0.0f) {
+			tExit = min(tExit, (x1 - origin[0]) / dir[0]);
+		}
+		else if (dir[0] < 0.0f) {
+			tExit = min(tExit, (x0 - origin[0]) / dir[0]);
+		}
+		if (dir[2] > 0.0f) {
+			tExit = min(tExit, (z1 - origin[2]) / dir[2]);
+		}
+		else if (dir[2] < 0.0f) {
+			tExit = min(tExit, (z0 - origin[2]) / dir[2]);
+		}
+
+		float y0 = origin[1] + dir[1] * tNode;
+		float y1 = origin[1] + dir[1] * tExit;
+		const vector<float> &level = levels[k];
+		float nodeMax = level[2 * (nz * levelWidths[k] + nx) + 1];
+		if (min(y0, y1) <= nodeMax) {
+			if (k > 0) {
+				k--;
+				continue;
+			}
+
+			//The ray dips below the top of this cell, so test its triangles,
+			//split along the same diagonal as the drawn triangle strips
+			Vec3f a((float)cx, terrain->getHeight(cx, cz), (float)cz);
+			Vec3f b((float)cx, terrain->getHeight(cx, cz + 1), (float)cz + 1);
+			Vec3f c((float)cx + 1, terrain->getHeight(cx + 1, cz), (float)cz);
+			Vec3f d((float)cx + 1, terrain->getHeight(cx + 1, cz + 1),
+					(float)cz + 1);
+			float best = FLT_MAX;
+			float tHit;
+			if (rayTriangle(origin, dir, a, b, c, tHit) && tHit >= tMin) {
+				best = tHit;
+			}
+			if (rayTriangle(origin, dir, b, c, d, tHit) && tHit >= tMin) {
+				best = min(best, tHit);
+			}
+			if (best <= tMax) {
+				t = best;
+				return true;
+			}
+		}
+		else if (k < top) {
+			//Nodes next to one that was passed over are usually passed over
+			//too, so look at the next one a level up
+			k++;
+		}
+
+		if (nudge == 0.0f) {
+			break;
+		}
+		//Rounding can put the ray in the node it just left, so always move on
+		tNode = max(tExit, tNode) + nudge;
+	}
+	return false;
+}
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,84 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+
+
+#ifndef HEIGHT_PYRAMID_H_INCLUDED
+#define HEIGHT_PYRAMID_H_INCLUDED
+
+#include <vector>
+
+#include "vec3f.h"
+
+class Terrain;
+struct TerrainRect;
+
+/* A hierarchy of minimum and maximum heights over a terrain.  Level 0 has the
+ * lowest and highest corner of each grid cell (the square between four
+ * neighbouring heights), and each node of level k + 1 covers a 2x2 block of
+ * level k.  A ray can skip any node whose highest point it passes over, so
+ * raycasts only descend to the cells near where the ray meets the terrain.
+ */
+class HeightPyramid {
+	private:
+		//The number of nodes across and along each level
+		std::vector<int> levelWidths;
+		std::vector<int> levelLengths;
+		//The minimum and maximum height of each node of each level, as
+		//consecutive pairs, row by row
+		std::vector<std::vector<float> > levels;
+
+		HeightPyramid(const HeightPyramid &other);
+		void operator=(const HeightPyramid &other);
+
+		//Recomputes level 0 for the cells cx0 <= x < cx1, cz0 <= z < cz1
+		void updateCells(Terrain* terrain, int cx0, int cz0, int cx1, int cz1);
+	public:
+		//Builds the pyramid over the current heights of terrain
+		explicit HeightPyramid(Terrain* terrain);
+
+		//Brings the pyramid up to date after the heights in rect changed
+		void update(Terrain* terrain, const TerrainRect &rect);
+
+		//Returns the lowest and highest height of the terrain
+		float minHeight() const;
+		float maxHeight() const;
+
+		//Finds the first point where the ray origin + t * dir, for
+		//0 <= t <= maxT, meets the surface drawn for terrain (two triangles
+		//per cell).  Returns whether there is one, and if so sets t.
+		bool raycast(Terrain* terrain, const Vec3f &origin, const Vec3f &dir,
+					 float maxT, float &t) const;
+};
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,189 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "horizonbake.h"
+
+using namespace std;
+
+namespace {
+	//The distances at which the horizon is sampled, sparser further out
+	const int SAMPLE_DISTANCES[] = {1, 2, 3, 4, 6, 8, 12, 16, 24, 32};
+	const int NUM_SAMPLES =
+		sizeof(SAMPLE_DISTANCES) / sizeof(SAMPLE_DISTANCES[0]);
+
+	//The directions searched, as steps between grid points
+	const int DIRECTIONS[8][2] = {
+		{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}
+	};
+}
+
+void occlusionRow(const HeightWindow &window, int z, int x0, int x1,
+				  unsigned char* out) {
+	for(int x = x0; x < x1; x++) {
+		float height = window.at(x, z);
+		float visible = 0.0f;
+		for(int d = 0; d < 8; d++) {
+			int dx = DIRECTIONS[d][0];
+			int dz = DIRECTIONS[d][1];
+			float stepLength = dx != 0 && dz != 0 ? 1.41421356f : 1.0f;
+
+			//Find the steepest rise towards the horizon, and count the sky
+			//above it as 1 - sin(elevation)
+			float maxSlope = 0.0f;
+			for(int i = 0; i < NUM_SAMPLES; i++) {
+				int sx = x + dx * SAMPLE_DISTANCES[i];
+				int sz = z + dz * SAMPLE_DISTANCES[i];
+				if (sx < window.x0 || sx >= window.x1 ||
+					sz < window.z0 || sz >= window.z1) {
+					break;
+				}
+				float slope = (window.at(sx, sz) - height) /
+					(SAMPLE_DISTANCES[i] * stepLength);
+				if (slope > maxSlope) {
+					maxSlope = slope;
+				}
+			}
+			visible += 1.0f - maxSlope / sqrtf(1.0f + maxSlope * maxSlope);
+		}
+		out[x - x0] = (unsigned char)(visible / 8.0f * 255.0f + 0.5f);
+	}
+}
+
+ShadowSweep::ShadowSweep(int w, int l, const Vec3f &toLight) {
+	float horizontal = sqrtf(toLight[0] * toLight[0] + toLight[2] * toLight[2]);
+	allShadowed = toLight[1] <= 0.0f;
+	allLit = !allShadowed && horizontal < 1e-6f * toLight[1];
+
+	alongX = fabsf(toLight[0]) >= fabsf(toLight[2]);
+	int numU = alongX ? w : l;
+	numCross = alongX ? l : w;
+	float lightU = alongX ? toLight[0] : toLight[2];
+	float lightV = alongX ? toLight[2] : toLight[0];
+
+	//Start at the edge nearest the light and walk away from it
+	uStep = lightU > 0.0f ? -1 : 1;
+	uStart = uStep > 0 ? 0 : numU - 1;
+	numSteps = allLit || allShadowed ? 0 : numU;
+	float slope = allLit || allShadowed ? 0.0f : -lightV / fabsf(lightU);
+	offsets.resize(numSteps);
+	for(int i = 0; i < numSteps; i++) {
+		offsets[i] = (int)floorf(i * slope + 0.5f);
+	}
+
+	//Each step covers sqrt(1 + slope^2) horizontally
+	stepDrop = allLit || allShadowed ? 0.0f
+		: sqrtf(1.0f + slope * slope) * toLight[1] / horizontal;
+}
+
+int ShadowSweep::firstLine() const {
+	return numSteps > 0 ? -max(offsets.back(), 0) : 0;
+}
+
+int ShadowSweep::endLine() const {
+	return numSteps > 0 ? numCross - min(offsets.back(), 0) : 0;
+}
+
+void ShadowSweep::linesThrough(const TerrainRect &rect, int &k0, int &k1) const {
+	if (numSteps == 0) {
+		k0 = k1 = 0;
+		return;
+	}
+	int u0 = alongX ? rect.x0 : rect.z0;
+	int u1 = alongX ? rect.x1 : rect.z1;
+	int v0 = alongX ? rect.z0 : rect.x0;
+	int v1 = alongX ? rect.z1 : rect.x1;
+	//The offsets change steadily along a line, so the extremes are at the
+	//ends of the rect
+	int offset0 = offsets[(u0 - uStart) * uStep];
+	int offset1 = offsets[(u1 - 1 - uStart) * uStep];
+	k0 = v0 - max(offset0, offset1);
+	k1 = v1 - min(offset0, offset1);
+}
+
+void ShadowSweep::stepsThrough(const TerrainRect &rect, int &i0, int &i1) const {
+	if (numSteps == 0) {
+		i0 = i1 = 0;
+		return;
+	}
+	int u0 = alongX ? rect.x0 : rect.z0;
+	int u1 = alongX ? rect.x1 : rect.z1;
+	int step0 = (u0 - uStart) * uStep;
+	int step1 = (u1 - 1 - uStart) * uStep;
+	i0 = min(step0, step1);
+	i1 = max(step0, step1) + 1;
+}
+
+int ShadowSweep::reach(float heightRange) const {
+	if (numSteps == 0) {
+		return 0;
+	}
+
+	//A shadow drops below the lowest height after heightRange / stepDrop
+	//steps.  Going SHADOW_SOFTNESS further keeps it clear of the rounding
+	//in the edge carried along the line.
+	float steps = ceilf((heightRange + SHADOW_SOFTNESS) / stepDrop) + 1.0f;
+	return steps >= numSteps ? numSteps : (int)steps;
+}
+
+TerrainRect ShadowSweep::shaded(const TerrainRect &rect, int reachSteps) const {
+	if (numSteps == 0 || reachSteps <= 0 || rect.isEmpty()) {
+		return rect;
+	}
+	int u0 = alongX ? rect.x0 : rect.z0;
+	int u1 = alongX ? rect.x1 : rect.z1;
+	int v0 = alongX ? rect.z0 : rect.x0;
+	int v1 = alongX ? rect.z1 : rect.x1;
+	if (uStep > 0) {
+		u1 += reachSteps;
+	}
+	else {
+		u0 -= reachSteps;
+	}
+
+	//Over reachSteps steps, a line moves across by the offset at that step,
+	//give or take one for the rounding
+	int across = abs(offsets[min(reachSteps, numSteps - 1)]) + 1;
+	if (offsets.back() > 0) {
+		v1 += across;
+	}
+	else if (offsets.back() < 0) {
+		v0 -= across;
+	}
+	return alongX ? TerrainRect(u0, v0, u1, v1) : TerrainRect(v0, u0, v1, u1);
+}
+
+
+
+
+
+
+
+
+
+
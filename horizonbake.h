@@ -0,0 +1,153 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef HORIZON_BAKE_H_INCLUDED
+#define HORIZON_BAKE_H_INCLUDED
+
+#include <vector>
+
+#include "terrain.h"
+#include "vec3f.h"
+
+//How far, in cells, the horizon of a cell is searched for its ambient
+//occlusion
+const int OCCLUSION_RADIUS = 32;
+
+//A block of heights, row by row, covering the cells x0 <= x < x1,
+//z0 <= z < z1 of a terrain
+struct HeightWindow {
+	const float* heights;
+	int stride;
+	int x0;
+	int z0;
+	int x1;
+	int z1;
+
+	float at(int x, int z) const {
+		return heights[(z - z0) * stride + (x - x0)];
+	}
+};
+
+//Computes the ambient occlusion of the cells x0 <= x < x1 of row z into out,
+//as the fraction of the sky visible from each, scaled to 0 - 255.  The
+//horizon is found in eight directions, out to OCCLUSION_RADIUS cells or the
+//edge of window, which must include those cells where they lie within the
+//terrain.
+void occlusionRow(const HeightWindow &window, int z, int x0, int x1,
+				  unsigned char* out);
+
+//The light's shadow edge is softened over this height, so shadows don't
+//alias along the grid
+const float SHADOW_SOFTNESS = 1.0f;
+
+/* The lines a shadow sweep follows across a w x l terrain, away from a
+ * directional light.  The lines run parallel to the light's horizontal
+ * direction, and each step of a line moves one cell along whichever of x and
+ * z that direction is closer to, and the nearest cell along the other axis.
+ * Every cell is on exactly one line, so walking each line and carrying the
+ * height of the shadow along it takes time linear in the terrain's size.
+ */
+class ShadowSweep {
+	private:
+		bool alongX; //Whether each step moves one cell in x
+		int uStart; //Where lines start along the step axis
+		int uStep; //1 or -1
+		int numSteps;
+		int numCross; //The size of the terrain across the step axis
+		std::vector<int> offsets; //How far each line has moved across the
+		                          //step axis at each step
+		float stepDrop;
+		bool allLit;
+		bool allShadowed;
+	public:
+		//Plans a sweep for the light in the direction toLight
+		ShadowSweep(int w, int l, const Vec3f &toLight);
+
+		//Returns the number of steps along each line
+		int steps() const {
+			return numSteps;
+		}
+
+		//Returns the range firstLine() <= k < endLine() of the lines
+		int firstLine() const;
+		int endLine() const;
+
+		//Returns how far the edge of a shadow drops at each step
+		float drop() const {
+			return stepDrop;
+		}
+
+		//Returns whether the light is straight overhead, so nothing is in
+		//shadow, or at or below the horizon, so everything is
+		bool isAllLit() const {
+			return allLit;
+		}
+
+		bool isAllShadowed() const {
+			return allShadowed;
+		}
+
+		//Sets (x, z) to the cell at step i of line k, and returns whether
+		//it is on the terrain
+		bool cell(int k, int i, int &x, int &z) const {
+			int u = uStart + i * uStep;
+			int v = k + offsets[i];
+			if (v < 0 || v >= numCross) {
+				return false;
+			}
+			x = alongX ? u : v;
+			z = alongX ? v : u;
+			return true;
+		}
+
+		//Sets k0 <= k < k1 to the lines through the cells of rect, which
+		//must not be empty
+		void linesThrough(const TerrainRect &rect, int &k0, int &k1) const;
+
+		//Sets i0 <= i < i1 to the steps at which lines cross rect, which
+		//must not be empty
+		void stepsThrough(const TerrainRect &rect, int &i0, int &i1) const;
+
+		//Returns how many steps along a line the shadow of a height can
+		//reach, on a terrain whose heights span heightRange.  A sweep that
+		//starts this many steps before a cell computes the same shadow for it
+		//as one that starts at the edge of the terrain.
+		int reach(float heightRange) const;
+
+		//Returns rect, extended away from the sun by the cells up to
+		//reachSteps steps further along the lines through it.  The result
+		//isn't clipped to the terrain.
+		TerrainRect shaded(const TerrainRect &rect, int reachSteps) const;
+};
+
+
+
+
+
+
+
+
+
+
+#endif
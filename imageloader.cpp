@@ -23,18 +23,42 @@
 
 
 #include <assert.h>
-#include <fstream>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
 
 #include "imageloader.h"
+#include "threadpool.h"
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#define PIXEL_KERNELS_SIMD
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
-Image::Image(char* ps, int w, int h) : pixels(ps), width(w), height(h) {
+Image::Image() : mapping(NULL), mappingBytes(0), buffer(NULL), pixels(NULL),
+	width(0), height(0), rows(NULL), rowStride(0), format(PIXELS_BGR) {
+	
+}
+
+Image::Image(char* ps, int w, int h) : mapping(NULL), mappingBytes(0),
+	buffer(NULL), pixels(ps), width(w), height(h), rows(NULL), rowStride(0),
+	format(PIXELS_BGR) {
 	
 }
 
 Image::~Image() {
 	delete[] pixels;
+	delete[] buffer;
+	if (mapping != NULL) {
+		munmap(mapping, mappingBytes);
+	}
 }
 
 namespace {
@@ -52,20 +76,6 @@ namespace {
 					   (unsigned char)bytes[0]);
 	}
 	
-	//Reads the next four bytes as an integer, using little-endian form
-	int readInt(ifstream &input) {
-		char buffer[4];
-		input.read(buffer, 4);
-		return toInt(buffer);
-	}
-	
-	//Reads the next two bytes as a short, using little-endian form
-	short readShort(ifstream &input) {
-		char buffer[2];
-		input.read(buffer, 2);
-		return toShort(buffer);
-	}
-	
 	//Just like auto_ptr, but for arrays
 	template<class T>
 	class auto_array {
@@ -130,37 +140,353 @@ namespace {
 				return array[i];
 			}
 	};
+
+	//The fewest bytes of pixels worth handing to another thread
+	const ptrdiff_t MIN_BAND_BYTES = 65536;
+
+	//Calls f(y0, y1) for bands of rows that together cover 0 <= y < height,
+	//on the threads of pool if it isn't NULL.  Each row is rowBytes long.
+	//Bands of a mapped image fault in their own span of the file.
+	void forEachRowBand(ThreadPool* pool, int height, ptrdiff_t rowBytes,
+						const function<void(int, int)> &f) {
+		if (pool == NULL) {
+			f(0, height);
+			return;
+		}
+		ptrdiff_t minRows = MIN_BAND_BYTES / max(rowBytes, (ptrdiff_t)1);
+		pool->parallelFor(0, height, (int)max(minRows, (ptrdiff_t)1), f);
+	}
+
+	//Sets out[i] to the level of the ith 4-bit palette index in in, for
+	//0 <= i < count.  Each byte of in holds two indices, high nibble first.
+	void unpack4(const unsigned char* in, const unsigned char* levels,
+				 unsigned char* out, int count) {
+		int i = 0;
+		for(; i + 2 <= count; i += 2) {
+			int pair = in[i / 2];
+			out[i] = levels[pair >> 4];
+			out[i + 1] = levels[pair & 15];
+		}
+		if (i < count) {
+			out[i] = levels[in[i / 2] >> 4];
+		}
+	}
+
+	/* Decodes the run-length encoded pixels from in up to end into out, a
+	 * byte per pixel, width pixels per row and bottom row first, giving each
+	 * pixel the level of its palette index.  rle4 selects RLE4, which packs
+	 * two indices per byte, high nibble first, rather than RLE8.  Pixels the
+	 * encoding skips, and the rest of the image if the data ends early, get
+	 * the level of index 0.
+	 */
+	void decodeRLE(const unsigned char* in, const unsigned char* end,
+				   bool rle4, const unsigned char* levels, unsigned char* out,
+				   int width, int height) {
+		size_t size = (size_t)width * height;
+		int x = 0;
+		int y = 0;
+		//Every pixel before (x, y) has been written.  Fills the pixels from
+		//there up to index pos, which the encoding skips.
+		auto skipTo = [&](size_t pos) {
+			size_t from = min((size_t)width * y + x, size);
+			pos = min(pos, size);
+			if (from < pos) {
+				memset(out + from, levels[0], pos - from);
+			}
+		};
+		while (y < height && end - in >= 2) {
+			int count = in[0];
+			int value = in[1];
+			in += 2;
+			unsigned char* row = out + (size_t)width * y;
+			if (count > 0) {
+				//A run of count pixels; pixels past the end of the row are
+				//dropped
+				int n = min(count, width - x);
+				unsigned char levelsOfPair[2] = {levels[value], levels[value]};
+				if (rle4) {
+					levelsOfPair[0] = levels[value >> 4];
+					levelsOfPair[1] = levels[value & 15];
+				}
+				if (levelsOfPair[0] == levelsOfPair[1]) {
+					memset(row + x, levelsOfPair[0], n);
+				}
+				else {
+					for(int i = 0; i < n; i++) {
+						row[x + i] = levelsOfPair[i & 1];
+					}
+				}
+				x += n;
+			}
+			else if (value == 0) {
+				//End of row
+				skipTo((size_t)width * (y + 1));
+				x = 0;
+				y++;
+			}
+			else if (value == 1) {
+				//End of bitmap
+				break;
+			}
+			else if (value == 2) {
+				//Move right and up
+				if (end - in < 2) {
+					break;
+				}
+				int newX = min(x + in[0], width);
+				int newY = y + in[1];
+				skipTo((size_t)width * newY + newX);
+				x = newX;
+				y = newY;
+				in += 2;
+			}
+			else {
+				//value indices, padded to a whole number of 16-bit words
+				int bytes = rle4 ? (value + 1) / 2 : value;
+				if (end - in < bytes) {
+					break;
+				}
+				int n = min(value, width - x);
+				if (!rle4) {
+					for(int i = 0; i < n; i++) {
+						row[x + i] = levels[in[i]];
+					}
+				}
+				else {
+					unpack4(in, levels, row + x, n);
+				}
+				x += n;
+				in += min((ptrdiff_t)(bytes + (bytes & 1)), end - in);
+			}
+		}
+		skipTo(size);
+	}
+
+	void bgrToRgbScalar(const unsigned char* in, unsigned char* out,
+						int count) {
+		for(int x = 0; x < count; x++) {
+			unsigned char blue = in[0];
+			out[0] = in[2];
+			out[1] = in[1];
+			out[2] = blue;
+			in += 3;
+			out += 3;
+		}
+	}
+
+#ifdef PIXEL_KERNELS_SIMD
+	/* The vector kernels shuffle four pixels at a time, in the low 12 bytes of
+	 * a 16-byte lane.  The bytes stored past each group of pixels are
+	 * overwritten by the next store, so the loops stop short of the end of
+	 * the row, and the scalar kernel finishes it.
+	 */
+
+	__attribute__((target("ssse3")))
+	void bgrToRgbSSSE3(const unsigned char* in, unsigned char* out,
+					   int count) {
+		const __m128i order = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6,
+											11, 10, 9, 12, 13, 14, 15);
+		int x = 0;
+		for(; x + 18 <= count; x += 16) {
+			const unsigned char* p = in + 3 * x;
+			unsigned char* q = out + 3 * x;
+			__m128i a = _mm_loadu_si128((const __m128i*)p);
+			__m128i b = _mm_loadu_si128((const __m128i*)(p + 12));
+			__m128i c = _mm_loadu_si128((const __m128i*)(p + 24));
+			__m128i d = _mm_loadu_si128((const __m128i*)(p + 36));
+			_mm_storeu_si128((__m128i*)q, _mm_shuffle_epi8(a, order));
+			_mm_storeu_si128((__m128i*)(q + 12), _mm_shuffle_epi8(b, order));
+			_mm_storeu_si128((__m128i*)(q + 24), _mm_shuffle_epi8(c, order));
+			_mm_storeu_si128((__m128i*)(q + 36), _mm_shuffle_epi8(d, order));
+		}
+		for(; x + 6 <= count; x += 4) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(in + 3 * x));
+			_mm_storeu_si128((__m128i*)(out + 3 * x), _mm_shuffle_epi8(a, order));
+		}
+		bgrToRgbScalar(in + 3 * x, out + 3 * x, count - x);
+	}
+
+	__attribute__((target("avx2")))
+	void bgrToRgbAVX2(const unsigned char* in, unsigned char* out,
+					  int count) {
+		//Eight pixels are loaded at a time, spread so that four start each
+		//lane, shuffled, and packed back together
+		const __m256i spread = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+		const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+		const __m256i order = _mm256_setr_epi8(
+			2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 12, 13, 14, 15,
+			2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 12, 13, 14, 15);
+		int x = 0;
+		for(; x + 35 <= count; x += 32) {
+			const unsigned char* p = in + 3 * x;
+			unsigned char* q = out + 3 * x;
+			for(int i = 0; i < 4; i++) {
+				__m256i v = _mm256_loadu_si256((const __m256i*)(p + 24 * i));
+				v = _mm256_permutevar8x32_epi32(v, spread);
+				v = _mm256_shuffle_epi8(v, order);
+				v = _mm256_permutevar8x32_epi32(v, pack);
+				_mm256_storeu_si256((__m256i*)(q + 24 * i), v);
+			}
+		}
+		//The SSSE3 kernel isn't VEX-encoded, so clear the upper halves of the
+		//registers first, or switching between the encodings stalls
+		_mm256_zeroupper();
+		bgrToRgbSSSE3(in + 3 * x, out + 3 * x, count - x);
+	}
+#endif
+
+	//Returns whether the CPU can run the given kernel
+	bool isSupported(PixelKernel kernel) {
+		switch(kernel) {
+			case PIXEL_KERNEL_SCALAR:
+				return true;
+#ifdef PIXEL_KERNELS_SIMD
+			case PIXEL_KERNEL_SSSE3:
+				return __builtin_cpu_supports("ssse3");
+			case PIXEL_KERNEL_AVX2:
+				return __builtin_cpu_supports("avx2");
+#endif
+			default:
+				return false;
+		}
+	}
+
+	//Returns the fastest kernel the CPU supports
+	PixelKernel bestKernel() {
+		if (isSupported(PIXEL_KERNEL_AVX2)) {
+			return PIXEL_KERNEL_AVX2;
+		}
+		if (isSupported(PIXEL_KERNEL_SSSE3)) {
+			return PIXEL_KERNEL_SSSE3;
+		}
+		return PIXEL_KERNEL_SCALAR;
+	}
+
+	PixelKernel currentKernel = bestKernel();
+}
+
+PixelKernel pixelKernel() {
+	return currentKernel;
+}
+
+PixelKernel setPixelKernel(PixelKernel kernel) {
+	currentKernel = isSupported(kernel) ? kernel : PIXEL_KERNEL_SCALAR;
+	return currentKernel;
+}
+
+void bgrToRgb(const unsigned char* in, unsigned char* out, int count) {
+	switch(currentKernel) {
+#ifdef PIXEL_KERNELS_SIMD
+		case PIXEL_KERNEL_AVX2:
+			bgrToRgbAVX2(in, out, count);
+			return;
+		case PIXEL_KERNEL_SSSE3:
+			bgrToRgbSSSE3(in, out, count);
+			return;
+#endif
+		default:
+			bgrToRgbScalar(in, out, count);
+	}
+}
+
+void Image::readGray(int y, float* out) {
+	const unsigned char* r = row(y);
+	switch(format) {
+		case PIXELS_BGR:
+			for(int x = 0; x < width; x++) {
+				out[x] = r[3 * x + 2] / 255.0f;
+			}
+			break;
+		case PIXELS_GRAY8:
+			for(int x = 0; x < width; x++) {
+				out[x] = r[x] / 255.0f;
+			}
+			break;
+		case PIXELS_GRAY16:
+			for(int x = 0; x < width; x++) {
+				out[x] = (r[2 * x] | (r[2 * x + 1] << 8)) / 65535.0f;
+			}
+			break;
+	}
 }
 
-Image* loadBMP(const char* filename) {
-	ifstream input;
-	input.open(filename, ifstream::binary);
-	assert(!input.fail() || !"Could not find file");
-	char buffer[2];
-	input.read(buffer, 2);
-	assert(buffer[0] == 'B' && buffer[1] == 'M' || !"Not a bitmap file");
-	input.ignore(8);
-	int dataOffset = readInt(input);
+char* Image::rgbPixels(ThreadPool* pool) {
+	if (pixels == NULL) {
+		auto_array<char> pixels2(new char[(size_t)width * height * 3]);
+		unsigned char* pixels3 = (unsigned char*)pixels2.get();
+		forEachRowBand(pool, height, (ptrdiff_t)3 * width, [&](int y0, int y1) {
+			for(int y = y0; y < y1; y++) {
+				const unsigned char* r = row(y);
+				unsigned char* out = pixels3 + (size_t)3 * width * y;
+				if (format == PIXELS_BGR) {
+					bgrToRgb(r, out, width);
+					continue;
+				}
+				for(int x = 0; x < width; x++) {
+					//Keep the high byte of 16-bit levels
+					unsigned char level =
+						format == PIXELS_GRAY8 ? r[x] : r[2 * x + 1];
+					out[3 * x] = out[3 * x + 1] = out[3 * x + 2] = level;
+				}
+			}
+		});
+		pixels = pixels2.release();
+	}
+	return pixels;
+}
+
+Image* loadBMP(const char* filename, ThreadPool* pool) {
+	//Swizzle straight out of the mapping, so the pixels are only copied once
+	Image* mapped = mapBMP(filename, pool);
+	Image* image = new Image(mapped->rgbPixels(pool), mapped->width,
+							 mapped->height);
+	mapped->pixels = NULL;
+	delete mapped;
+	return image;
+}
+
+Image* mapBMP(const char* filename, ThreadPool* pool) {
+	int fd = open(filename, O_RDONLY);
+	assert(fd >= 0 || !"Could not find file");
+	struct stat info;
+	fstat(fd, &info);
+	size_t size = (size_t)info.st_size;
+	assert(size >= 26 || !"Not a bitmap file");
+	void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	assert(mapping != MAP_FAILED || !"Could not map file");
+	const char* file = (const char*)mapping;
+	assert((file[0] == 'B' && file[1] == 'M') || !"Not a bitmap file");
+	int dataOffset = toInt(file + 10);
 	
 	//Read the header
-	int headerSize = readInt(input);
+	const char* header = file + 14;
+	int headerSize = toInt(header);
 	int width;
 	int height;
+	int bitsPerPixel;
+	int compression;
+	int paletteSize; //The number of palette entries
+	int paletteEntryBytes;
 	switch(headerSize) {
 		case 40:
 			//V3
-			width = readInt(input);
-			height = readInt(input);
-			input.ignore(2);
-			assert(readShort(input) == 24 || !"Image is not 24 bits per pixel");
-			assert(readShort(input) == 0 || !"Image is compressed");
+			assert(size >= 54 || !"Not a bitmap file");
+			width = toInt(header + 4);
+			height = toInt(header + 8);
+			bitsPerPixel = toShort(header + 14);
+			compression = toInt(header + 16);
+			paletteSize = toInt(header + 32);
+			paletteEntryBytes = 4;
 			break;
 		case 12:
 			//OS/2 V1
-			width = readShort(input);
-			height = readShort(input);
-			input.ignore(2);
-			assert(readShort(input) == 24 || !"Image is not 24 bits per pixel");
+			width = toShort(header + 4);
+			height = toShort(header + 6);
+			bitsPerPixel = toShort(header + 10);
+			compression = 0;
+			paletteSize = 0;
+			paletteEntryBytes = 3;
 			break;
 		case 64:
 			//OS/2 V2
@@ -177,27 +503,104 @@ Image* loadBMP(const char* filename) {
 		default:
 			assert(!"Unknown bitmap format");
 	}
+	assert((bitsPerPixel == 4 || bitsPerPixel == 8 || bitsPerPixel == 16 ||
+			bitsPerPixel == 24) ||
+		   !"Image is not 4, 8, 16 or 24 bits per pixel");
+	//1 is RLE8 and 2 is RLE4
+	assert((compression == 0 || (compression == 1 && bitsPerPixel == 8) ||
+			(compression == 2 && bitsPerPixel == 4)) ||
+		   !"Unknown bitmap compression");
 	
-	//Read the data
-	int bytesPerRow = ((width * 3 + 3) / 4) * 4 - (width * 3 % 4);
-	int size = bytesPerRow * height;
-	auto_array<char> pixels(new char[size]);
-	input.seekg(dataOffset, ios_base::beg);
-	input.read(pixels.get(), size);
+	//Rows are padded to a multiple of four bytes.  A negative height means
+	//that they are stored from the top of the image down.
+	bool topDown = height < 0;
+	if (topDown) {
+		height = -height;
+	}
+	assert(!(topDown && compression != 0) || !"Bitmap is malformed");
+	ptrdiff_t bytesPerRow = ((ptrdiff_t)width * bitsPerPixel + 31) / 32 * 4;
+	assert((dataOffset >= 0 && dataOffset <= (ptrdiff_t)size &&
+			(compression != 0 ||
+			 dataOffset + bytesPerRow * height <= (ptrdiff_t)size)) ||
+		   !"Bitmap is truncated");
+	madvise(mapping, size, MADV_SEQUENTIAL);
 	
-	//Get the data into the right format
-	auto_array<char> pixels2(new char[width * height * 3]);
-	for(int y = 0; y < height; y++) {
-		for(int x = 0; x < width; x++) {
-			for(int c = 0; c < 3; c++) {
-				pixels2[3 * (width * y + x) + c] =
-					pixels[bytesPerRow * y + 3 * x + (2 - c)];
-			}
+	Image* image = new Image();
+	image->mapping = mapping;
+	image->mappingBytes = size;
+	image->width = width;
+	image->height = height;
+	image->rows = (const unsigned char*)file + dataOffset;
+	image->rowStride = bytesPerRow;
+	if (topDown) {
+		image->rows += (height - 1) * bytesPerRow;
+		image->rowStride = -bytesPerRow;
+	}
+	image->format = bitsPerPixel == 24 ? PIXELS_BGR
+		: (bitsPerPixel == 16 ? PIXELS_GRAY16 : PIXELS_GRAY8);
+	if (bitsPerPixel > 8) {
+		return image;
+	}
+	
+	//Look the pixels up in the palette, which follows the header, unless
+	//each index is already the gray level
+	if (paletteSize <= 0 || paletteSize > (1 << bitsPerPixel)) {
+		paletteSize = 1 << bitsPerPixel;
+	}
+	const unsigned char* palette =
+		(const unsigned char*)header + headerSize;
+	assert(14 + headerSize + paletteSize * paletteEntryBytes <= (int)size ||
+		   !"Bitmap is truncated");
+	unsigned char levels[256];
+	bool isGray = true;
+	for(int i = 0; i < 256; i++) {
+		if (i < paletteSize) {
+			const unsigned char* entry = palette + i * paletteEntryBytes;
+			levels[i] = entry[2];
+			isGray = isGray && entry[0] == i && entry[1] == i && entry[2] == i;
+		}
+		else {
+			levels[i] = 0;
 		}
 	}
+	if (isGray && bitsPerPixel == 8 && compression == 0) {
+		return image;
+	}
 	
-	input.close();
-	return new Image(pixels2.release(), width, height);
+	image->buffer = new unsigned char[(size_t)width * height];
+	if (compression != 0) {
+		//The encoded pixels end at the end of the file, or sooner if the
+		//header gives their size
+		const unsigned char* data = (const unsigned char*)file + dataOffset;
+		ptrdiff_t dataBytes = (ptrdiff_t)size - dataOffset;
+		ptrdiff_t encodedBytes = (unsigned int)toInt(header + 20);
+		if (encodedBytes > 0 && encodedBytes < dataBytes) {
+			dataBytes = encodedBytes;
+		}
+		decodeRLE(data, data + dataBytes, compression == 2, levels,
+				  image->buffer, width, height);
+	}
+	else {
+		forEachRowBand(pool, height, width, [&](int y0, int y1) {
+			for(int y = y0; y < y1; y++) {
+				const unsigned char* in = image->row(y);
+				unsigned char* out = image->buffer + (size_t)width * y;
+				if (bitsPerPixel == 8) {
+					for(int x = 0; x < width; x++) {
+						out[x] = levels[in[x]];
+					}
+				}
+				else {
+					unpack4(in, levels, out, width);
+				}
+			}
+		});
+	}
+	image->rows = image->buffer;
+	image->rowStride = width;
+	munmap(mapping, size);
+	image->mapping = NULL;
+	return image;
 }
 
 
@@ -208,3 +611,4 @@ Image* loadBMP(const char* filename) {
 
 
 
+
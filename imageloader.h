@@ -25,8 +25,30 @@
 #ifndef IMAGE_LOADER_H_INCLUDED
 #define IMAGE_LOADER_H_INCLUDED
 
+#include <stddef.h>
+
+class ThreadPool;
+
+//The ways the rows of an image from mapBMP can store its pixels
+enum PixelFormat {
+	PIXELS_BGR,   //Three bytes per pixel, in the order (B, G, R)
+	PIXELS_GRAY8, //A byte per pixel
+	PIXELS_GRAY16 //A little-endian 16-bit gray level per pixel
+};
+
 //Represents an image
 class Image {
+	private:
+		void* mapping; //The file the image was mapped from, or NULL
+		size_t mappingBytes;
+		unsigned char* buffer; //The rows, if they were decoded into memory
+		                       //rather than mapped, or NULL
+
+		Image();
+		Image(const Image &other);
+		void operator=(const Image &other);
+
+		friend Image* mapBMP(const char* filename, ThreadPool* pool);
 	public:
 		Image(char* ps, int w, int h);
 		~Image();
@@ -35,15 +57,71 @@ class Image {
 		 * color of each pixel in image.  Color components range from 0 to 255.
 		 * The array starts the bottom-left pixel, then moves right to the end
 		 * of the row, then moves up to the next column, and so on.  This is the
-		 * format in which OpenGL likes images.
+		 * format in which OpenGL likes images.  For an image from mapBMP, this
+		 * is NULL until rgbPixels is called.
 		 */
 		char* pixels;
 		int width;
 		int height;
+
+		/* For an image from mapBMP, row 0 of the pixels, in the given format.
+		 * Row y starts y * rowStride bytes after it, so rows go from the
+		 * bottom of the image to the top, like pixels.  rows is NULL for other
+		 * images.
+		 */
+		const unsigned char* rows;
+		ptrdiff_t rowStride;
+		PixelFormat format;
+
+		//Returns the start of row y of rows
+		const unsigned char* row(int y) {
+			return rows + y * rowStride;
+		}
+
+		//Copies the gray levels of row y of rows to out, from 0 to 1.  The
+		//level of a PIXELS_BGR pixel is its red component.
+		void readGray(int y, float* out);
+
+		//Returns pixels, filling it in from rows first if needed, on the
+		//threads of pool if it isn't NULL.  Gray pixels become (L, L, L).
+		char* rgbPixels(ThreadPool* pool = NULL);
+};
+
+//The implementations of bgrToRgb
+enum PixelKernel {
+	PIXEL_KERNEL_SCALAR,
+	PIXEL_KERNEL_SSSE3,
+	PIXEL_KERNEL_AVX2
 };
 
-//Reads a bitmap image from file.
-Image* loadBMP(const char* filename);
+//Returns the kernel in use.  By default, this is the fastest one the CPU
+//supports.
+PixelKernel pixelKernel();
+
+//Switches to the given kernel, falling back to the scalar one if the CPU
+//doesn't support it.  Returns the kernel now in use.
+PixelKernel setPixelKernel(PixelKernel kernel);
+
+//Copies count (B, G, R) pixels from in to out as (R, G, B).  in and out must
+//not overlap.
+void bgrToRgb(const unsigned char* in, unsigned char* out, int count);
+
+//Reads a bitmap image from file.  If pool isn't NULL, the pixels are
+//converted on its threads, a band of rows each.
+Image* loadBMP(const char* filename, ThreadPool* pool = NULL);
+
+//Maps a bitmap image from file, without reading or converting its pixels
+//where it can.  The returned image has rows, and no pixels until rgbPixels is
+//called.  24-bit bitmaps give PIXELS_BGR images.  4 and 8-bit ones give
+//PIXELS_GRAY8 images of the red component of each pixel's palette entry,
+//which for a grayscale palette is its gray level; they are decoded into
+//memory unless they are uncompressed 8-bit bitmaps with the plain grayscale
+//palette.  RLE8 and RLE4 compression are supported.  16-bit bitmaps are
+//taken to hold a gray level per pixel, as heightmap tools write them, rather
+//than 5-5-5 color, and give PIXELS_GRAY16 images.  If pool isn't NULL,
+//uncompressed rows that need decoding are decoded on its threads; RLE data
+//has to be decoded in order, on the calling thread.
+Image* mapBMP(const char* filename, ThreadPool* pool = NULL);
 
 
 
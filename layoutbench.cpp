@@ -0,0 +1,155 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "terrain.h"
+
+using namespace std;
+
+namespace {
+	//The radius, in cells, of the square read around each point by the
+	//neighbourhood benchmark
+	const int NEIGHBOURHOOD_RADIUS = 8;
+
+	//Returns the average time f() takes, in nanoseconds per cell it reads
+	template<class F>
+	double nanosPerCell(size_t cells, int repeats, const F &f) {
+		f();
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for(int i = 0; i < repeats; i++) {
+			f();
+		}
+		chrono::duration<double, nano> nanos =
+			chrono::steady_clock::now() - start;
+		return nanos.count() / ((double)cells * repeats);
+	}
+}
+
+//Measures how fast the heights of a terrain stored row by row and one stored
+//in tiles are read at random cells, in squares around random points, and row
+//by row:
+//
+//    layoutbench [size] [points] [repeats]
+//
+//The default is a 4096 x 4096 terrain, read at 1000000 random points (and
+//around 10000 of them), 5 times.
+int main(int argc, char** argv) {
+	int size = argc > 1 ? atoi(argv[1]) : 4096;
+	int numPoints = argc > 2 ? atoi(argv[2]) : 1000000;
+	int repeats = argc > 3 ? atoi(argv[3]) : 5;
+	if (size <= 2 * NEIGHBOURHOOD_RADIUS || numPoints <= 0 || repeats <= 0) {
+		cerr << "Usage: " << argv[0] << " [size] [points] [repeats]" << endl;
+		return 1;
+	}
+
+	//The same random points for both layouts, with room for a neighbourhood
+	//around each
+	vector<int> xs(numPoints);
+	vector<int> zs(numPoints);
+	unsigned int seed = 12345;
+	for(int i = 0; i < numPoints; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		xs[i] = NEIGHBOURHOOD_RADIUS +
+			(int)((seed >> 8) % (size - 2 * NEIGHBOURHOOD_RADIUS));
+		seed = seed * 1664525u + 1013904223u;
+		zs[i] = NEIGHBOURHOOD_RADIUS +
+			(int)((seed >> 8) % (size - 2 * NEIGHBOURHOOD_RADIUS));
+	}
+	int numCentres = max(numPoints / 100, 1);
+	int side = 2 * NEIGHBOURHOOD_RADIUS + 1;
+
+	cout << fixed << setprecision(2);
+	cout << size << " x " << size << " heights, "
+		 << ((size_t)size * size * sizeof(float) >> 20) << " MB" << endl;
+	const char* names[] = {"rows", "tiled"};
+	TerrainLayout layouts[] = {LAYOUT_ROWS, LAYOUT_TILED};
+	double expected = 0.0;
+	for(int k = 0; k < 2; k++) {
+		Terrain t(size, size, NORMALS_FLOAT, layouts[k]);
+		t.fillHeights([size](int z, float* row) {
+			for(int x = 0; x < size; x++) {
+				row[x] = sinf(x * 0.01f) * cosf(z * 0.013f);
+			}
+		});
+
+		//Sum what is read, so that the reads aren't optimized away, and so
+		//that the layouts can be checked against each other
+		double sum = 0.0;
+		double randomTime = nanosPerCell(numPoints, repeats, [&]() {
+			for(int i = 0; i < numPoints; i++) {
+				sum += t.getHeight(xs[i], zs[i]);
+			}
+		});
+		double neighbourhoodTime =
+			nanosPerCell((size_t)numCentres * side * side, repeats, [&]() {
+				for(int i = 0; i < numCentres; i++) {
+					for(int z = zs[i] - NEIGHBOURHOOD_RADIUS;
+						z <= zs[i] + NEIGHBOURHOOD_RADIUS; z++) {
+						for(int x = xs[i] - NEIGHBOURHOOD_RADIUS;
+							x <= xs[i] + NEIGHBOURHOOD_RADIUS; x++) {
+							sum += t.getHeight(x, z);
+						}
+					}
+				}
+			});
+		vector<float> row(size);
+		double rowTime =
+			nanosPerCell((size_t)size * size, repeats, [&]() {
+				for(int z = 0; z < size; z++) {
+					t.readHeights(z, 0, size, &row[0]);
+					sum += row[z];
+				}
+			});
+
+		cout << names[k] << ": random " << randomTime << " ns, "
+			 << side << " x " << side << " neighbourhoods "
+			 << neighbourhoodTime << " ns, rows " << rowTime
+			 << " ns per cell";
+		if (k == 0) {
+			expected = sum;
+		}
+		else if (sum != expected) {
+			cout << " (read different heights from the row layout)";
+		}
+		cout << endl;
+	}
+	return 0;
+}
+
+
+
+
+
+
+
+
+
+
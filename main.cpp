@@ -24,6 +24,7 @@
 #include <string.h>
 
 #include <iostream>
+#include <vector>
 #include <stdlib.h>
 #include <math.h>
 #ifdef __APPLE__
@@ -36,182 +37,26 @@
 #endif
 
 #define PI 3.14159265
+#include "arena.h"
+#include "heightmaps.h"
 #include "imageloader.h"
+#include "terrain.h"
+#include "terrainedit.h"
+#include "terraingen.h"
+#include "terrainlod.h"
+#include "terrainstream.h"
+#include "threadpool.h"
+#include "tinmesh.h"
 #include "vec3f.h"
 
 using namespace std;
 
-//Represents a terrain, by storing a set of heights and normals at 2D locations
-class Terrain {
-	private:
-		int w; //Width
-		int l; //Length
-		float** hs; //Heights
-		Vec3f** normals;
-		bool computedNormals; //Whether normals is up-to-date
-	public:
-		Terrain(int w2, int l2) {
-			w = w2;
-			l = l2;
-			
-			hs = new float*[l];
-			for(int i = 0; i < l; i++) {
-				hs[i] = new float[w];
-			}
-			
-			normals = new Vec3f*[l];
-			for(int i = 0; i < l; i++) {
-				normals[i] = new Vec3f[w];
-			}
-			
-			computedNormals = false;
-		}
-		
-		~Terrain() {
-			for(int i = 0; i < l; i++) {
-				delete[] hs[i];
-			}
-			delete[] hs;
-			
-			for(int i = 0; i < l; i++) {
-				delete[] normals[i];
-			}
-			delete[] normals;
-		}
-		
-		int width() {
-			return w;
-		}
-		
-		int length() {
-			return l;
-		}
-		
-		//Sets the height at (x, z) to y
-		void setHeight(int x, int z, float y) {
-			hs[z][x] = y;
-			computedNormals = false;
-		}
-		
-		//Returns the height at (x, z)
-		float getHeight(int x, int z) {
-			return hs[z][x];
-		}
-		
-		//Computes the normals, if they haven't been computed yet
-		void computeNormals() {
-			if (computedNormals) {
-				return;
-			}
-			
-			//Compute the rough version of the normals
-			Vec3f** normals2 = new Vec3f*[l];
-			for(int i = 0; i < l; i++) {
-				normals2[i] = new Vec3f[w];
-			}
-			
-			for(int z = 0; z < l; z++) {
-				for(int x = 0; x < w; x++) {
-					Vec3f sum(0.0f, 0.0f, 0.0f);
-					
-					Vec3f out;
-					if (z > 0) {
-						out = Vec3f(0.0f, hs[z - 1][x] - hs[z][x], -1.0f);
-					}
-					Vec3f in;
-					if (z < l - 1) {
-						in = Vec3f(0.0f, hs[z + 1][x] - hs[z][x], 1.0f);
-					}
-					Vec3f left;
-					if (x > 0) {
-						left = Vec3f(-1.0f, hs[z][x - 1] - hs[z][x], 0.0f);
-					}
-					Vec3f right;
-					if (x < w - 1) {
-						right = Vec3f(1.0f, hs[z][x + 1] - hs[z][x], 0.0f);
-					}
-					
-					if (x > 0 && z > 0) {
-						sum += out.cross(left).normalize();
-					}
-					if (x > 0 && z < l - 1) {
-						sum += left.cross(in).normalize();
-					}
-					if (x < w - 1 && z < l - 1) {
-						sum += in.cross(right).normalize();
-					}
-					if (x < w - 1 && z > 0) {
-						sum += right.cross(out).normalize();
-					}
-					
-					normals2[z][x] = sum;
-				}
-			}
-			
-			//Smooth out the normals
-			const float FALLOUT_RATIO = 0.5f;
-			for(int z = 0; z < l; z++) {
-				for(int x = 0; x < w; x++) {
-					Vec3f sum = normals2[z][x];
-					
-					if (x > 0) {
-						sum += normals2[z][x - 1] * FALLOUT_RATIO;
-					}
-					if (x < w - 1) {
-						sum += normals2[z][x + 1] * FALLOUT_RATIO;
-					}
-					if (z > 0) {
-						sum += normals2[z - 1][x] * FALLOUT_RATIO;
-					}
-					if (z < l - 1) {
-						sum += normals2[z + 1][x] * FALLOUT_RATIO;
-					}
-					
-					if (sum.magnitude() == 0) {
-						sum = Vec3f(0.0f, 1.0f, 0.0f);
-					}
-					normals[z][x] = sum;
-				}
-			}
-			
-			for(int i = 0; i < l; i++) {
-				delete[] normals2[i];
-			}
-			delete[] normals2;
-			
-			computedNormals = true;
-		}
-		
-		//Returns the normal at (x, z)
-		Vec3f getNormal(int x, int z) {
-			if (!computedNormals) {
-				computeNormals();
-			}
-			return normals[z][x];
-		}
-};
-
-//Loads a terrain from a heightmap.  The heights of the terrain range from
-//-height / 2 to height / 2.
-Terrain* loadTerrain(const char* filename, float height) {
-	Image* image = loadBMP(filename);
-	Terrain* t = new Terrain(image->width, image->height);
-	for(int y = 0; y < image->height; y++) {
-		for(int x = 0; x < image->width; x++) {
-			unsigned char color =
-				(unsigned char)image->pixels[3 * (y * image->width + x)];
-			float h = height * ((color / 255.0f) - 0.5f);
-			t->setHeight(x, y, h);
-		}
-	}
-	
-	delete image;
-	t->computeNormals();
-	return t;
-}
-
 float _angle = -140.0f;
 Terrain* _terrain;
+TerrainLod* _terrainLod;
+TinMesh* _tin; //Drawn instead of _terrainLod if it isn't NULL
+ThreadPool* _threadPool;
+Arena* _arena; //Holds the buffers of _terrain
 float theta= 350.0f;
 float yax=-3.0;
 float xax=6.0;
@@ -228,8 +73,23 @@ int cam=1;
 float savy=0.0;
 int score=30;
 
+//The scene's lights
+const float AMBIENT_LIGHT = 0.4f;
+const float SUN_LIGHT = 0.6f;
+const Vec3f TO_SUN(-0.5f, 0.8f, 0.1f);
+
+//How much the top speeds up per update on a slope of 1, downhill
+const float SLOPE_PULL = 0.1f;
+
+//How many updates ahead to read a mapped terrain along the top's path
+const float PREFETCH_UPDATES = 40.0f;
+
 void cleanup() {
+	delete _tin;
+	delete _terrainLod;
 	delete _terrain;
+	delete _arena;
+	delete _threadPool;
 }
 
 void handleKeypress(unsigned char key, int x, int y) {
@@ -502,6 +362,10 @@ void detect()
 	if(sqrt((xpos-tarx)*(xpos-tarx)+(zpos-tarz-22)*(zpos-tarz-22))<7.5)
 	{
 	score+=1;
+	_terrainLod->invalidate(digCrater(_terrain, xpos, zpos, 4.0f, 2.0f));
+	//The mesh only fits the map as it was, so go back to the grid
+	delete _tin;
+	_tin = NULL;
     _angle = -140.0f;
 	theta= 350.0f;
 	yax=-3.0;
@@ -520,6 +384,15 @@ void detect()
 	 savy=0.0;
 	}
 }
+//Sets the colour of a terrain vertex to how OpenGL would light it, with the
+//ambient light scaled by the baked occlusion and the sun by the baked shadows
+void terrainColor(const Vec3f &normal, float occlusion, float shadow) {
+	float diffuse = normal.normalize().dot(TO_SUN.normalize());
+	float light = AMBIENT_LIGHT * occlusion +
+		SUN_LIGHT * (diffuse > 0.0f ? diffuse : 0.0f) * shadow;
+	glColor3f(0.69f * light, 0.3f * light, 0.2f * light);
+}
+
 void drawScene() {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	
@@ -534,14 +407,16 @@ void drawScene() {
 	
 
 	handleKeypress('0',0,0);
+	//The camera sits where the translation set up above takes to the origin
+	Vec3f eye(-xax, -yax, -zax);
 
 
 	glPushMatrix();
-	GLfloat ambientColor[] = {0.4f, 0.4f, 0.4f, 1.0f};
+	GLfloat ambientColor[] = {AMBIENT_LIGHT, AMBIENT_LIGHT, AMBIENT_LIGHT, 1.0f};
 	glLightModelfv(GL_LIGHT_MODEL_AMBIENT, ambientColor);
 	
-	GLfloat lightColor0[] = {0.6f, 0.6f, 0.6f, 1.0f};
-	GLfloat lightPos0[] = {-0.5f, 0.8f, 0.1f, 0.0f};
+	GLfloat lightColor0[] = {SUN_LIGHT, SUN_LIGHT, SUN_LIGHT, 1.0f};
+	GLfloat lightPos0[] = {TO_SUN[0], TO_SUN[1], TO_SUN[2], 0.0f};
 	glLightfv(GL_LIGHT0, GL_DIFFUSE, lightColor0);
 	glLightfv(GL_LIGHT0, GL_POSITION, lightPos0);
 	
@@ -571,18 +446,6 @@ void drawScene() {
 		yax=savy/5-3;
 		
 	}
-	/*if((_terrain->getHeight((int)xpos,(int)zpos)-_terrain->getHeight((int)(xpos+xvel),(int)(zpos+zvel)))>0.0)
-	{
-			xvel-=0.5;
-			zvel-=0.5;
-	}
-	if((_terrain->getHeight((int)xpos,(int)zpos)-_terrain->getHeight((int)(xpos+xvel),(int)(zpos+zvel)))<0.0)
-	{
-			xvel+=0.5;
-			zvel+=0.5;
-	}
-*/
-
 	glBegin(GL_LINES);
 	glColor3f(0,0.7,1);
     glVertex2f(0,0);
@@ -592,30 +455,53 @@ void drawScene() {
 	//cout<<xvel<<" "<<zvel<<endl;
 	glRotatef(-90,1.0,0,0);
 	glScalef(5, 5, 5);
-	Vec3f normal = _terrain->getNormal(xpos, zpos);
-	Vec3f vertical=Vec3f(0.0,1.0,0.0);
-	Vec3f perp=vertical.cross(normal).normalize();
-	glRotatef(acos(vertical.dot(normal)/(normal.magnitude()*vertical.magnitude()))*180.0/PI,perp.v[0],perp.v[1],perp.v[2]);
+	//Tilt the top with the slope under it, about the horizontal axis
+	//perpendicular to the slope
+	float dhdx, dhdz;
+	_terrain->getGradient(xpos, zpos, dhdx, dhdz);
+	float slope = sqrt(dhdx * dhdx + dhdz * dhdz);
+	if (slope > 0.0f) {
+		glRotatef(atan(slope) * 180.0 / PI, -dhdz / slope, 0.0f, dhdx / slope);
+	}
 
 
  	drawTop();
 	glPopMatrix();
 	
 	glPushMatrix();
-	glColor3f(0.69f, 0.3f, 0.2f);
-	for(int z = 0; z < _terrain->length() - 1; z++) {
-		
-		glBegin(GL_TRIANGLE_STRIP);
-		for(int x = 0; x < _terrain->width(); x++) {
-			Vec3f normal = _terrain->getNormal(x, z);
-			glNormal3f(normal[0], normal[1], normal[2]);
-			glVertex3f(x, _terrain->getHeight(x, z), z);
-			normal = _terrain->getNormal(x, z + 1);
-			glNormal3f(normal[0], normal[1], normal[2]);
-			glVertex3f(x, _terrain->getHeight(x, z + 1), z + 1);
+	//The terrain is lit from its baked occlusion and shadows instead
+	glDisable(GL_LIGHTING);
+	if (_tin != NULL) {
+		glBegin(GL_TRIANGLES);
+		for(size_t i = 0; i < _tin->triangles.size(); i++) {
+			const Vec3f &position = _tin->vertices[_tin->triangles[i]];
+			int x = (int)position[0];
+			int z = (int)position[2];
+			terrainColor(_tin->normals[_tin->triangles[i]],
+						 _terrain->getAmbientOcclusion(x, z),
+						 _terrain->getShadow(x, z));
+			glVertex3f(position[0], position[1], position[2]);
 		}
 		glEnd();
 	}
+	else {
+		_terrainLod->update(eye / scale +
+							Vec3f((float)(_terrain->width() - 1) / 2, 0.0f,
+								  (float)(_terrain->length() - 1) / 2));
+		for(int i = 0; i < _terrainLod->numStrips(); i++) {
+			int count;
+			const LodVertex* strip = _terrainLod->strip(i, count);
+			glBegin(GL_TRIANGLE_STRIP);
+			for(int j = 0; j < count; j++) {
+				const Vec3f &position = strip[j].position;
+				terrainColor(strip[j].normal, strip[j].occlusion,
+							 strip[j].shadow);
+				glVertex3f(position[0], position[1], position[2]);
+			}
+			glEnd();
+		}
+	}
+	glEnable(GL_LIGHTING);
 	glPopMatrix();
 
 	glPushMatrix();
@@ -636,6 +522,22 @@ void update(int value) {
 	
 	xpos+=xvel;
 	zpos+=zvel;
+	//Keep the top on the map, stopping it at the edges
+	if (xpos < 0.0f || xpos > _terrain->width() - 1) {
+		xpos = max(0.0f, min(xpos, (float)(_terrain->width() - 1)));
+		xvel = 0.0f;
+	}
+	if (zpos < 0.0f || zpos > _terrain->length() - 1) {
+		zpos = max(0.0f, min(zpos, (float)(_terrain->length() - 1)));
+		zvel = 0.0f;
+	}
+	//Roll downhill, unless friction holds the top on a gentle slope
+	float dhdx, dhdz;
+	_terrain->getGradient(xpos, zpos, dhdx, dhdz);
+	xvel -= SLOPE_PULL * dhdx;
+	zvel -= SLOPE_PULL * dhdz;
+	_terrain->prefetch(xpos, zpos, PREFETCH_UPDATES * xvel,
+					   PREFETCH_UPDATES * zvel);
 	if (xvel>-0.08&&xvel<0.08)
 	{
 		xvel=0.0;
@@ -672,7 +574,60 @@ int main(int argc, char** argv) {
 	glutCreateWindow("Assignment 2");
 	initRendering();
 	
-	_terrain = loadTerrain("heightmap.bmp", 20);
+	_threadPool = new ThreadPool();
+	_arena = new Arena();
+	//A mesh made from the map by tinsimplify, given last, is drawn in place
+	//of the grid
+	const char* tin = NULL;
+	if (argc > 2 && hasExtension(argv[argc - 1], ".tin")) {
+		tin = argv[--argc];
+	}
+
+	//A .ter map, as made by maketer, is mapped from disk a tile at a time,
+	//rather than loaded up front
+	const char* map = argc > 1 ? argv[1] : "heightmap.bmp";
+	//Names that only start with digits, like 1k.bmp, are files
+	char* sizeEnd;
+	long size = strtol(map, &sizeEnd, 10);
+	if (map[0] >= '0' && map[0] <= '9' && *sizeEnd == '\0' && size > 0) {
+		//A number asks for a generated map that many cells across, with the
+		//seed given after it
+		unsigned int seed = argc > 2 ? (unsigned int)atoi(argv[2]) : 1;
+		_terrain = generateTerrain((int)size, (int)size, 20, seed,
+								   _threadPool, NORMALS_FLOAT, HEIGHTS_FLOAT,
+								   LAYOUT_ROWS, _arena);
+	}
+	else if (hasExtension(map, ".ter")) {
+		_terrain = mapTerrain(map, 64 << 20);
+		if (_terrain == NULL) {
+			cout << "Not a terrain file: " << map << endl;
+			return 1;
+		}
+		_terrain->setThreadPool(_threadPool);
+	}
+	else {
+		_terrain = loadHeightmap(map, 20, _threadPool, NORMALS_FLOAT,
+								 HEIGHTS_FLOAT, LAYOUT_ROWS, _arena);
+		if (_terrain == NULL) {
+			cout << "Not a heightmap: " << map << endl;
+			return 1;
+		}
+	}
+	//Bake the ambient occlusion and shadows now rather than on the first
+	//frame.  A mapped terrain only marks its tiles, and bakes the occlusion
+	//and shadows of each block of them as it is used.
+	_terrain->setLightDirection(TO_SUN);
+	_terrain->computeAmbientOcclusion();
+	_terrain->computeShadows();
+	_terrainLod = new TerrainLod(_terrain);
+	if (tin != NULL) {
+		_tin = loadTin(tin);
+		if (_tin == NULL || _tin->width != _terrain->width() ||
+			_tin->length != _terrain->length()) {
+			cout << "Not a mesh of " << map << ": " << tin << endl;
+			return 1;
+		}
+	}
 	
 	glutDisplayFunc(drawScene);
 	glutKeyboardFunc(handleKeypress);
@@ -0,0 +1,77 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+
+#include "heightmaps.h"
+#include "terrain.h"
+#include "terrainstream.h"
+#include "threadpool.h"
+
+using namespace std;
+
+//Converts a heightmap into a tiled .ter file, which the game maps from disk a
+//tile at a time rather than loading it up front:
+//
+//    maketer heightmap.bmp heightmap.ter [height] [float]
+//
+//The heightmap may also be a .pgm or square .raw file.  height scales it as
+//the game does.  The heights are stored in 16 bits unless float is given.
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		cerr << "Usage: " << argv[0]
+			 << " heightmap.bmp out.ter [height] [float]" << endl;
+		return 1;
+	}
+	float height = argc > 3 ? (float)atof(argv[3]) : 20.0f;
+	HeightFormat heightFormat = argc > 4 && strcmp(argv[4], "float") == 0
+		? HEIGHTS_FLOAT : HEIGHTS_UINT16;
+
+	ThreadPool pool;
+	Terrain* terrain = loadHeightmap(argv[1], height, &pool, NORMALS_OCT16,
+									 heightFormat);
+	if (terrain == NULL) {
+		cerr << "Not a heightmap: " << argv[1] << endl;
+		return 1;
+	}
+	saveTerrain(terrain, argv[2]);
+	cout << terrain->width() << " x " << terrain->length() << " heights, "
+		 << (heightFormat == HEIGHTS_FLOAT ? "float" : "16-bit") << endl;
+
+	delete terrain;
+	return 0;
+}
+
+
+
+
+
+
+
+
+
+
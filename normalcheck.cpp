@@ -0,0 +1,214 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <string.h>
+
+#include <iostream>
+#include <vector>
+
+#include "normalkernels.h"
+#include "terrain.h"
+#include "threadpool.h"
+#include "vec3f.h"
+
+using namespace std;
+
+namespace {
+	//A random height, from a fixed sequence so that failures can be rerun
+	unsigned int seed = 12345;
+	float randomHeight() {
+		seed = seed * 1664525u + 1013904223u;
+		return ((seed >> 8) / 16777216.0f - 0.5f) * 20.0f;
+	}
+
+	//Computes the normals of the w x l heights hs into normals, row by row,
+	//the way Terrain did before the row kernels, one cell at a time
+	void baselineNormals(const vector<float> &hs, int w, int l,
+						 vector<Vec3f> &normals) {
+		//Compute the rough version of the normals
+		vector<Vec3f> normals2(hs.size());
+		for(int z = 0; z < l; z++) {
+			for(int x = 0; x < w; x++) {
+				float h = hs[z * w + x];
+				Vec3f sum(0.0f, 0.0f, 0.0f);
+
+				Vec3f out;
+				if (z > 0) {
+					out = Vec3f(0.0f, hs[(z - 1) * w + x] - h, -1.0f);
+				}
+				Vec3f in;
+				if (z < l - 1) {
+					in = Vec3f(0.0f, hs[(z + 1) * w + x] - h, 1.0f);
+				}
+				Vec3f left;
+				if (x > 0) {
+					left = Vec3f(-1.0f, hs[z * w + x - 1] - h, 0.0f);
+				}
+				Vec3f right;
+				if (x < w - 1) {
+					right = Vec3f(1.0f, hs[z * w + x + 1] - h, 0.0f);
+				}
+
+				if (x > 0 && z > 0) {
+					sum += out.cross(left).normalize();
+				}
+				if (x > 0 && z < l - 1) {
+					sum += left.cross(in).normalize();
+				}
+				if (x < w - 1 && z < l - 1) {
+					sum += in.cross(right).normalize();
+				}
+				if (x < w - 1 && z > 0) {
+					sum += right.cross(out).normalize();
+				}
+
+				normals2[z * w + x] = sum;
+			}
+		}
+
+		//Smooth out the normals
+		const float FALLOUT_RATIO = 0.5f;
+		normals.resize(hs.size());
+		for(int z = 0; z < l; z++) {
+			for(int x = 0; x < w; x++) {
+				Vec3f sum = normals2[z * w + x];
+
+				if (x > 0) {
+					sum += normals2[z * w + x - 1] * FALLOUT_RATIO;
+				}
+				if (x < w - 1) {
+					sum += normals2[z * w + x + 1] * FALLOUT_RATIO;
+				}
+				if (z > 0) {
+					sum += normals2[(z - 1) * w + x] * FALLOUT_RATIO;
+				}
+				if (z < l - 1) {
+					sum += normals2[(z + 1) * w + x] * FALLOUT_RATIO;
+				}
+
+				if (sum.magnitude() == 0) {
+					sum = Vec3f(0.0f, 1.0f, 0.0f);
+				}
+				normals[z * w + x] = sum;
+			}
+		}
+	}
+
+	//Returns the number of cells of t whose normals aren't bit for bit the
+	//same as those in expected
+	int countDifferences(Terrain* t, const vector<Vec3f> &expected) {
+		int count = 0;
+		for(int z = 0; z < t->length(); z++) {
+			for(int x = 0; x < t->width(); x++) {
+				Vec3f normal = t->getNormal(x, z);
+				if (memcmp(&normal, &expected[z * t->width() + x],
+						   sizeof(Vec3f)) != 0) {
+					count++;
+				}
+			}
+		}
+		return count;
+	}
+
+	/* Checks the normals the current kernel computes for a w x l terrain of
+	 * random heights against baselineNormals, on the threads of pool if it
+	 * isn't NULL, first for the whole terrain and then after a few heights
+	 * change.  Returns whether they matched.
+	 */
+	bool checkNormals(int w, int l, ThreadPool* pool) {
+		vector<float> hs((size_t)w * l);
+		for(size_t i = 0; i < hs.size(); i++) {
+			hs[i] = randomHeight();
+		}
+		Terrain t(w, l);
+		t.setThreadPool(pool);
+		for(int z = 0; z < l; z++) {
+			for(int x = 0; x < w; x++) {
+				t.setHeight(x, z, hs[z * w + x]);
+			}
+		}
+		vector<Vec3f> expected;
+		baselineNormals(hs, w, l, expected);
+		int differences = countDifferences(&t, expected);
+
+		//Change heights in the corners and the middle, so only the normals
+		//near them are computed again
+		int xs[] = {0, w - 1, w / 2};
+		int zs[] = {0, l - 1, l / 2};
+		for(int i = 0; i < 3; i++) {
+			float height = randomHeight();
+			hs[zs[i] * w + xs[i]] = height;
+			t.setHeight(xs[i], zs[i], height);
+		}
+		baselineNormals(hs, w, l, expected);
+		int editDifferences = countDifferences(&t, expected);
+
+		cout << "    " << w << " x " << l
+			 << (pool != NULL ? " with a pool: " : ": ");
+		if (differences == 0 && editDifferences == 0) {
+			cout << "ok" << endl;
+			return true;
+		}
+		cout << differences << " normals differ, and " << editDifferences
+			 << " after edits" << endl;
+		return false;
+	}
+}
+
+//Checks that each normal kernel the CPU supports computes the same normals,
+//bit for bit, as the scalar code Terrain used before the kernels, on terrains
+//of odd sizes, with and without a thread pool
+int main() {
+	const int sizes[][2] = {
+		{1, 1}, {1, 5}, {7, 3}, {9, 1}, {33, 17}, {257, 129}, {701, 303}
+	};
+	const char* kernelNames[] = {"scalar", "SSE2", "AVX2"};
+	NormalKernel kernels[] = {NORMAL_KERNEL_SCALAR, NORMAL_KERNEL_SSE2,
+							  NORMAL_KERNEL_AVX2};
+	ThreadPool pool;
+	bool ok = true;
+	for(int k = 0; k < 3; k++) {
+		if (setNormalKernel(kernels[k]) != kernels[k]) {
+			cout << kernelNames[k] << " kernel: not supported" << endl;
+			continue;
+		}
+		cout << kernelNames[k] << " kernel:" << endl;
+		for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			ok = checkNormals(sizes[i][0], sizes[i][1], NULL) && ok;
+			ok = checkNormals(sizes[i][0], sizes[i][1], &pool) && ok;
+		}
+	}
+	cout << (ok ? "ok" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,461 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <algorithm>
+
+#include "normalkernels.h"
+
+#if defined(__SSE2__)
+#define NORMAL_KERNELS_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define NORMAL_KERNELS_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+using namespace std;
+
+/* The vector kernels evaluate the same expressions as the scalar ones, in the
+ * same order, so all of the kernels produce bit-identical normals.  The cross
+ * products of the edge vectors are written out component by component; with
+ * a, b, c and d the height differences to the cells before, after, left of and
+ * right of a cell, they are (c, 1, a), (c, 1, -b), (-d, 1, -b) and (-d, 1, a).
+ */
+
+namespace {
+	const float FALLOUT_RATIO = 0.5f;
+
+	//Computes the rough normal of the cell at x, using Vec3f
+	void roughNormal(const float* above, const float* row, const float* below,
+					 int w, int x, const NormalRowSoA &dest) {
+		Vec3f sum(0.0f, 0.0f, 0.0f);
+
+		Vec3f out;
+		if (above != NULL) {
+			out = Vec3f(0.0f, above[x] - row[x], -1.0f);
+		}
+		Vec3f in;
+		if (below != NULL) {
+			in = Vec3f(0.0f, below[x] - row[x], 1.0f);
+		}
+		Vec3f left;
+		if (x > 0) {
+			left = Vec3f(-1.0f, row[x - 1] - row[x], 0.0f);
+		}
+		Vec3f right;
+		if (x < w - 1) {
+			right = Vec3f(1.0f, row[x + 1] - row[x], 0.0f);
+		}
+
+		if (x > 0 && above != NULL) {
+			sum += out.cross(left).normalize();
+		}
+		if (x > 0 && below != NULL) {
+			sum += left.cross(in).normalize();
+		}
+		if (x < w - 1 && below != NULL) {
+			sum += in.cross(right).normalize();
+		}
+		if (x < w - 1 && above != NULL) {
+			sum += right.cross(out).normalize();
+		}
+
+		dest.x[x] = sum[0];
+		dest.y[x] = sum[1];
+		dest.z[x] = sum[2];
+	}
+
+	//Computes the smoothed normal of the cell at x, using Vec3f
+	void smoothNormal(const NormalRowSoA* above, const NormalRowSoA &row,
+					  const NormalRowSoA* below, int w, int x, Vec3f* out) {
+		Vec3f sum(row.x[x], row.y[x], row.z[x]);
+
+		if (x > 0) {
+			sum += Vec3f(row.x[x - 1], row.y[x - 1], row.z[x - 1]) *
+				FALLOUT_RATIO;
+		}
+		if (x < w - 1) {
+			sum += Vec3f(row.x[x + 1], row.y[x + 1], row.z[x + 1]) *
+				FALLOUT_RATIO;
+		}
+		if (above != NULL) {
+			sum += Vec3f(above->x[x], above->y[x], above->z[x]) *
+				FALLOUT_RATIO;
+		}
+		if (below != NULL) {
+			sum += Vec3f(below->x[x], below->y[x], below->z[x]) *
+				FALLOUT_RATIO;
+		}
+
+		if (sum.magnitude() == 0) {
+			sum = Vec3f(0.0f, 1.0f, 0.0f);
+		}
+		out[x] = sum;
+	}
+
+	void roughNormalsRowScalar(const float* above, const float* row,
+							   const float* below, int w, int x0, int x1,
+							   const NormalRowSoA &out) {
+		for(int x = x0; x < x1; x++) {
+			roughNormal(above, row, below, w, x, out);
+		}
+	}
+
+	void smoothNormalsRowScalar(const NormalRowSoA* above,
+								const NormalRowSoA &row,
+								const NormalRowSoA* below,
+								int w, int x0, int x1, Vec3f* out) {
+		for(int x = x0; x < x1; x++) {
+			smoothNormal(above, row, below, w, x, out);
+		}
+	}
+
+#ifdef NORMAL_KERNELS_SSE2
+	void roughNormalsRowSSE2(const float* above, const float* row,
+							 const float* below, int w, int x0, int x1,
+							 const NormalRowSoA &out) {
+		if (above == NULL || below == NULL) {
+			roughNormalsRowScalar(above, row, below, w, x0, x1, out);
+			return;
+		}
+
+		//Only cells with all four neighbours take the vector path
+		int x = x0;
+		for(; x < x1 && x < 1; x++) {
+			roughNormal(above, row, below, w, x, out);
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		int end = min(x1, w - 1);
+		for(; x + 4 <= end; x += 4) {
+			__m128 h = _mm_loadu_ps(row + x);
+			__m128 a = _mm_sub_ps(_mm_loadu_ps(above + x), h);
+			__m128 b = _mm_sub_ps(_mm_loadu_ps(below + x), h);
+			__m128 c = _mm_sub_ps(_mm_loadu_ps(row + x - 1), h);
+			__m128 d = _mm_sub_ps(_mm_loadu_ps(row + x + 1), h);
+			__m128 nb = _mm_xor_ps(b, sign);
+			__m128 nd = _mm_xor_ps(d, sign);
+
+			__m128 aa = _mm_mul_ps(a, a);
+			__m128 bb = _mm_mul_ps(b, b);
+			__m128 cc1 = _mm_add_ps(_mm_mul_ps(c, c), one);
+			__m128 dd1 = _mm_add_ps(_mm_mul_ps(d, d), one);
+			__m128 m1 = _mm_sqrt_ps(_mm_add_ps(cc1, aa));
+			__m128 m2 = _mm_sqrt_ps(_mm_add_ps(cc1, bb));
+			__m128 m3 = _mm_sqrt_ps(_mm_add_ps(dd1, bb));
+			__m128 m4 = _mm_sqrt_ps(_mm_add_ps(dd1, aa));
+
+			__m128 sx = _mm_add_ps(zero, _mm_div_ps(c, m1));
+			sx = _mm_add_ps(sx, _mm_div_ps(c, m2));
+			sx = _mm_add_ps(sx, _mm_div_ps(nd, m3));
+			sx = _mm_add_ps(sx, _mm_div_ps(nd, m4));
+			__m128 sy = _mm_add_ps(zero, _mm_div_ps(one, m1));
+			sy = _mm_add_ps(sy, _mm_div_ps(one, m2));
+			sy = _mm_add_ps(sy, _mm_div_ps(one, m3));
+			sy = _mm_add_ps(sy, _mm_div_ps(one, m4));
+			__m128 sz = _mm_add_ps(zero, _mm_div_ps(a, m1));
+			sz = _mm_add_ps(sz, _mm_div_ps(nb, m2));
+			sz = _mm_add_ps(sz, _mm_div_ps(nb, m3));
+			sz = _mm_add_ps(sz, _mm_div_ps(a, m4));
+
+			_mm_storeu_ps(out.x + x, sx);
+			_mm_storeu_ps(out.y + x, sy);
+			_mm_storeu_ps(out.z + x, sz);
+		}
+
+		for(; x < x1; x++) {
+			roughNormal(above, row, below, w, x, out);
+		}
+	}
+
+	void smoothNormalsRowSSE2(const NormalRowSoA* above,
+							  const NormalRowSoA &row,
+							  const NormalRowSoA* below,
+							  int w, int x0, int x1, Vec3f* out) {
+		if (above == NULL || below == NULL) {
+			smoothNormalsRowScalar(above, row, below, w, x0, x1, out);
+			return;
+		}
+
+		int x = x0;
+		for(; x < x1 && x < 1; x++) {
+			smoothNormal(above, row, below, w, x, out);
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 ratio = _mm_set1_ps(FALLOUT_RATIO);
+		const float* in[3] = {row.x, row.y, row.z};
+		const float* up[3] = {above->x, above->y, above->z};
+		const float* down[3] = {below->x, below->y, below->z};
+		int end = min(x1, w - 1);
+		for(; x + 4 <= end; x += 4) {
+			__m128 s[3];
+			for(int c = 0; c < 3; c++) {
+				s[c] = _mm_loadu_ps(in[c] + x);
+				s[c] = _mm_add_ps(s[c],
+					_mm_mul_ps(_mm_loadu_ps(in[c] + x - 1), ratio));
+				s[c] = _mm_add_ps(s[c],
+					_mm_mul_ps(_mm_loadu_ps(in[c] + x + 1), ratio));
+				s[c] = _mm_add_ps(s[c],
+					_mm_mul_ps(_mm_loadu_ps(up[c] + x), ratio));
+				s[c] = _mm_add_ps(s[c],
+					_mm_mul_ps(_mm_loadu_ps(down[c] + x), ratio));
+			}
+
+			__m128 m = _mm_add_ps(_mm_add_ps(_mm_mul_ps(s[0], s[0]),
+											 _mm_mul_ps(s[1], s[1])),
+								  _mm_mul_ps(s[2], s[2]));
+			__m128 flat = _mm_cmpeq_ps(m, zero);
+			s[0] = _mm_andnot_ps(flat, s[0]);
+			s[1] = _mm_or_ps(_mm_and_ps(flat, one), _mm_andnot_ps(flat, s[1]));
+			s[2] = _mm_andnot_ps(flat, s[2]);
+
+			float lanes[3][4];
+			for(int c = 0; c < 3; c++) {
+				_mm_storeu_ps(lanes[c], s[c]);
+			}
+			for(int i = 0; i < 4; i++) {
+				out[x + i] = Vec3f(lanes[0][i], lanes[1][i], lanes[2][i]);
+			}
+		}
+
+		for(; x < x1; x++) {
+			smoothNormal(above, row, below, w, x, out);
+		}
+	}
+#endif
+
+#ifdef NORMAL_KERNELS_AVX2
+	__attribute__((target("avx2")))
+	void roughNormalsRowAVX2(const float* above, const float* row,
+							 const float* below, int w, int x0, int x1,
+							 const NormalRowSoA &out) {
+		if (above == NULL || below == NULL) {
+			roughNormalsRowScalar(above, row, below, w, x0, x1, out);
+			return;
+		}
+
+		int x = x0;
+		for(; x < x1 && x < 1; x++) {
+			roughNormal(above, row, below, w, x, out);
+		}
+
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		int end = min(x1, w - 1);
+		for(; x + 8 <= end; x += 8) {
+			__m256 h = _mm256_loadu_ps(row + x);
+			__m256 a = _mm256_sub_ps(_mm256_loadu_ps(above + x), h);
+			__m256 b = _mm256_sub_ps(_mm256_loadu_ps(below + x), h);
+			__m256 c = _mm256_sub_ps(_mm256_loadu_ps(row + x - 1), h);
+			__m256 d = _mm256_sub_ps(_mm256_loadu_ps(row + x + 1), h);
+			__m256 nb = _mm256_xor_ps(b, sign);
+			__m256 nd = _mm256_xor_ps(d, sign);
+
+			__m256 aa = _mm256_mul_ps(a, a);
+			__m256 bb = _mm256_mul_ps(b, b);
+			__m256 cc1 = _mm256_add_ps(_mm256_mul_ps(c, c), one);
+			__m256 dd1 = _mm256_add_ps(_mm256_mul_ps(d, d), one);
+			__m256 m1 = _mm256_sqrt_ps(_mm256_add_ps(cc1, aa));
+			__m256 m2 = _mm256_sqrt_ps(_mm256_add_ps(cc1, bb));
+			__m256 m3 = _mm256_sqrt_ps(_mm256_add_ps(dd1, bb));
+			__m256 m4 = _mm256_sqrt_ps(_mm256_add_ps(dd1, aa));
+
+			__m256 sx = _mm256_add_ps(zero, _mm256_div_ps(c, m1));
+			sx = _mm256_add_ps(sx, _mm256_div_ps(c, m2));
+			sx = _mm256_add_ps(sx, _mm256_div_ps(nd, m3));
+			sx = _mm256_add_ps(sx, _mm256_div_ps(nd, m4));
+			__m256 sy = _mm256_add_ps(zero, _mm256_div_ps(one, m1));
+			sy = _mm256_add_ps(sy, _mm256_div_ps(one, m2));
+			sy = _mm256_add_ps(sy, _mm256_div_ps(one, m3));
+			sy = _mm256_add_ps(sy, _mm256_div_ps(one, m4));
+			__m256 sz = _mm256_add_ps(zero, _mm256_div_ps(a, m1));
+			sz = _mm256_add_ps(sz, _mm256_div_ps(nb, m2));
+			sz = _mm256_add_ps(sz, _mm256_div_ps(nb, m3));
+			sz = _mm256_add_ps(sz, _mm256_div_ps(a, m4));
+
+			_mm256_storeu_ps(out.x + x, sx);
+			_mm256_storeu_ps(out.y + x, sy);
+			_mm256_storeu_ps(out.z + x, sz);
+		}
+
+		for(; x < x1; x++) {
+			roughNormal(above, row, below, w, x, out);
+		}
+	}
+
+	__attribute__((target("avx2")))
+	void smoothNormalsRowAVX2(const NormalRowSoA* above,
+							  const NormalRowSoA &row,
+							  const NormalRowSoA* below,
+							  int w, int x0, int x1, Vec3f* out) {
+		if (above == NULL || below == NULL) {
+			smoothNormalsRowScalar(above, row, below, w, x0, x1, out);
+			return;
+		}
+
+		int x = x0;
+		for(; x < x1 && x < 1; x++) {
+			smoothNormal(above, row, below, w, x, out);
+		}
+
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 ratio = _mm256_set1_ps(FALLOUT_RATIO);
+		const float* in[3] = {row.x, row.y, row.z};
+		const float* up[3] = {above->x, above->y, above->z};
+		const float* down[3] = {below->x, below->y, below->z};
+		int end = min(x1, w - 1);
+		for(; x + 8 <= end; x += 8) {
+			__m256 s[3];
+			for(int c = 0; c < 3; c++) {
+				s[c] = _mm256_loadu_ps(in[c] + x);
+				s[c] = _mm256_add_ps(s[c],
+					_mm256_mul_ps(_mm256_loadu_ps(in[c] + x - 1), ratio));
+				s[c] = _mm256_add_ps(s[c],
+					_mm256_mul_ps(_mm256_loadu_ps(in[c] + x + 1), ratio));
+				s[c] = _mm256_add_ps(s[c],
+					_mm256_mul_ps(_mm256_loadu_ps(up[c] + x), ratio));
+				s[c] = _mm256_add_ps(s[c],
+					_mm256_mul_ps(_mm256_loadu_ps(down[c] + x), ratio));
+			}
+
+			__m256 m = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(s[0], s[0]),
+							  _mm256_mul_ps(s[1], s[1])),
+				_mm256_mul_ps(s[2], s[2]));
+			__m256 flat = _mm256_cmp_ps(m, zero, _CMP_EQ_OQ);
+			s[0] = _mm256_andnot_ps(flat, s[0]);
+			s[1] = _mm256_blendv_ps(s[1], one, flat);
+			s[2] = _mm256_andnot_ps(flat, s[2]);
+
+			float lanes[3][8];
+			for(int c = 0; c < 3; c++) {
+				_mm256_storeu_ps(lanes[c], s[c]);
+			}
+			for(int i = 0; i < 8; i++) {
+				out[x + i] = Vec3f(lanes[0][i], lanes[1][i], lanes[2][i]);
+			}
+		}
+
+		for(; x < x1; x++) {
+			smoothNormal(above, row, below, w, x, out);
+		}
+	}
+#endif
+
+	//Returns whether the CPU can run the given kernel
+	bool isSupported(NormalKernel kernel) {
+		switch(kernel) {
+			case NORMAL_KERNEL_SCALAR:
+				return true;
+			case NORMAL_KERNEL_SSE2:
+#ifdef NORMAL_KERNELS_SSE2
+				return true;
+#else
+				return false;
+#endif
+			case NORMAL_KERNEL_AVX2:
+#ifdef NORMAL_KERNELS_AVX2
+				return __builtin_cpu_supports("avx2");
+#else
+				return false;
+#endif
+		}
+		return false;
+	}
+
+	//Returns the fastest kernel the CPU supports
+	NormalKernel bestKernel() {
+		if (isSupported(NORMAL_KERNEL_AVX2)) {
+			return NORMAL_KERNEL_AVX2;
+		}
+		if (isSupported(NORMAL_KERNEL_SSE2)) {
+			return NORMAL_KERNEL_SSE2;
+		}
+		return NORMAL_KERNEL_SCALAR;
+	}
+
+	NormalKernel currentKernel = bestKernel();
+}
+
+NormalKernel normalKernel() {
+	return currentKernel;
+}
+
+NormalKernel setNormalKernel(NormalKernel kernel) {
+	currentKernel = isSupported(kernel) ? kernel : NORMAL_KERNEL_SCALAR;
+	return currentKernel;
+}
+
+void roughNormalsRow(const float* above, const float* row, const float* below,
+					 int w, int x0, int x1, const NormalRowSoA &out) {
+	switch(currentKernel) {
+#ifdef NORMAL_KERNELS_AVX2
+		case NORMAL_KERNEL_AVX2:
+			roughNormalsRowAVX2(above, row, below, w, x0, x1, out);
+			return;
+#endif
+#ifdef NORMAL_KERNELS_SSE2
+		case NORMAL_KERNEL_SSE2:
+			roughNormalsRowSSE2(above, row, below, w, x0, x1, out);
+			return;
+#endif
+		default:
+			roughNormalsRowScalar(above, row, below, w, x0, x1, out);
+	}
+}
+
+void smoothNormalsRow(const NormalRowSoA* above, const NormalRowSoA &row,
+					  const NormalRowSoA* below, int w, int x0, int x1,
+					  Vec3f* out) {
+	switch(currentKernel) {
+#ifdef NORMAL_KERNELS_AVX2
+		case NORMAL_KERNEL_AVX2:
+			smoothNormalsRowAVX2(above, row, below, w, x0, x1, out);
+			return;
+#endif
+#ifdef NORMAL_KERNELS_SSE2
+		case NORMAL_KERNEL_SSE2:
+			smoothNormalsRowSSE2(above, row, below, w, x0, x1, out);
+			return;
+#endif
+		default:
+			smoothNormalsRowScalar(above, row, below, w, x0, x1, out);
+	}
+}
+
+
+
+
+
+
+
+
+
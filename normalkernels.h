@@ -0,0 +1,77 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef NORMAL_KERNELS_H_INCLUDED
+#define NORMAL_KERNELS_H_INCLUDED
+
+#include "vec3f.h"
+
+//One row of normals, stored as separate arrays of x, y and z components.  The
+//arrays are indexed by the x coordinate of the terrain cell.
+struct NormalRowSoA {
+	float* x;
+	float* y;
+	float* z;
+};
+
+//The implementations of the row kernels below
+enum NormalKernel {
+	NORMAL_KERNEL_SCALAR,
+	NORMAL_KERNEL_SSE2,
+	NORMAL_KERNEL_AVX2
+};
+
+//Returns the kernel in use.  By default, this is the fastest one the CPU
+//supports.
+NormalKernel normalKernel();
+
+//Switches to the given kernel, falling back to the scalar one if the CPU
+//doesn't support it.  Returns the kernel now in use.
+NormalKernel setNormalKernel(NormalKernel kernel);
+
+//Computes the rough normals of the cells x0 <= x < x1 of a terrain row that
+//is w cells wide, into out.  row holds the heights of the row, and above and
+//below the heights of the rows before and after it, or NULL at the edges of
+//the terrain.
+void roughNormalsRow(const float* above, const float* row, const float* below,
+					 int w, int x0, int x1, const NormalRowSoA &out);
+
+//Smooths the rough normals of the cells x0 <= x < x1 of a terrain row that is
+//w cells wide, into out.  row holds the rough normals of the row, and above
+//and below those of the rows before and after it, or NULL at the edges of
+//the terrain.
+void smoothNormalsRow(const NormalRowSoA* above, const NormalRowSoA &row,
+					  const NormalRowSoA* below, int w, int x0, int x1,
+					  Vec3f* out);
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,118 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef OCT_NORMAL_H_INCLUDED
+#define OCT_NORMAL_H_INCLUDED
+
+#include <math.h>
+
+#include "vec3f.h"
+
+/* Octahedral encoding of unit vectors.  A direction is projected onto the
+ * octahedron |x| + |y| + |z| = 1, whose lower half is folded over the upper
+ * half, and the x and z coordinates of the result are stored as two signed
+ * fixed-point numbers.  The y axis is the pole, so the upward-facing normals
+ * of a terrain get the most even precision.  Only the direction survives;
+ * decoded vectors have unit length.
+ */
+
+namespace octnormal {
+	inline float signNotZero(float f) {
+		return f < 0.0f ? -1.0f : 1.0f;
+	}
+
+	//Projects n onto the folded octahedron, as (u, v) in [-1, 1]
+	inline void project(const Vec3f &n, float &u, float &v) {
+		float s = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+		u = n[0] / s;
+		v = n[2] / s;
+		if (n[1] < 0.0f) {
+			float t = u;
+			u = (1.0f - fabsf(v)) * signNotZero(t);
+			v = (1.0f - fabsf(t)) * signNotZero(v);
+		}
+	}
+
+	//Returns the unit vector at (u, v) on the folded octahedron
+	inline Vec3f unproject(float u, float v) {
+		float y = 1.0f - fabsf(u) - fabsf(v);
+		if (y < 0.0f) {
+			float t = u;
+			u = (1.0f - fabsf(v)) * signNotZero(t);
+			v = (1.0f - fabsf(t)) * signNotZero(v);
+		}
+		float m = sqrtf(u * u + y * y + v * v);
+		return Vec3f(u / m, y / m, v / m);
+	}
+
+	//Rounds f in [-1, 1] to a signed integer in [-scale, scale]
+	inline int quantize(float f, float scale) {
+		if (f > 1.0f) {
+			f = 1.0f;
+		}
+		else if (f < -1.0f) {
+			f = -1.0f;
+		}
+		return (int)floorf(f * scale + 0.5f);
+	}
+}
+
+//Encodes the direction of n in 32 bits, 16 per coordinate
+inline unsigned int encodeOct32(const Vec3f &n) {
+	float u, v;
+	octnormal::project(n, u, v);
+	return (unsigned int)(unsigned short)octnormal::quantize(u, 32767.0f) |
+		((unsigned int)(unsigned short)octnormal::quantize(v, 32767.0f) << 16);
+}
+
+//Decodes a direction encoded by encodeOct32
+inline Vec3f decodeOct32(unsigned int bits) {
+	return octnormal::unproject((short)(bits & 0xffff) / 32767.0f,
+								(short)(bits >> 16) / 32767.0f);
+}
+
+//Encodes the direction of n in 16 bits, 8 per coordinate
+inline unsigned short encodeOct16(const Vec3f &n) {
+	float u, v;
+	octnormal::project(n, u, v);
+	return (unsigned short)((unsigned char)octnormal::quantize(u, 127.0f) |
+		((unsigned char)octnormal::quantize(v, 127.0f) << 8));
+}
+
+//Decodes a direction encoded by encodeOct16
+inline Vec3f decodeOct16(unsigned short bits) {
+	return octnormal::unproject((signed char)(bits & 0xff) / 127.0f,
+								(signed char)(bits >> 8) / 127.0f);
+}
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,367 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "imageloader.h"
+
+using namespace std;
+
+namespace {
+	//Returns the average throughput of f(), in megabytes of pixels read per
+	//second
+	template<class F>
+	double throughput(size_t bytes, int repeats, const F &f) {
+		f();
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for(int i = 0; i < repeats; i++) {
+			f();
+		}
+		chrono::duration<double> seconds =
+			chrono::steady_clock::now() - start;
+		return bytes * (double)repeats / seconds.count() / (1 << 20);
+	}
+
+	//Appends value to out in little-endian form, in the given number of bytes
+	void putLittleEndian(vector<unsigned char> &out, int value, int bytes) {
+		for(int i = 0; i < bytes; i++) {
+			out.push_back((unsigned char)(value >> (8 * i)));
+		}
+	}
+
+	//Returns the number of pixels from x, before end and at most 255, with the
+	//index of pixel x
+	int runLength(const unsigned char* row, int x, int end) {
+		int count = 1;
+		while (x + count < end && count < 255 && row[x + count] == row[x]) {
+			count++;
+		}
+		return count;
+	}
+
+	/* Run-length encodes the width x height palette indices in indices, a
+	 * byte per pixel and bottom row first, as RLE4 if rle4 is true and RLE8
+	 * otherwise.  Runs of 3 or more pixels become run records, except runs of
+	 * index 0, which delta records skip, as do end-of-line records at the end
+	 * of a row and an end-of-bitmap record after the last row that isn't all
+	 * index 0.  Pixels between runs go in absolute records.
+	 */
+	vector<unsigned char> encodeRLE(const vector<unsigned char> &indices,
+									int width, int height, bool rle4) {
+		vector<unsigned char> out;
+		int rows = height;
+		while (rows > 0 &&
+			   count(&indices[(size_t)width * (rows - 1)],
+					 &indices[(size_t)width * rows], 0) == width) {
+			rows--;
+		}
+		for(int y = 0; y < rows; y++) {
+			const unsigned char* row = &indices[(size_t)width * y];
+			int end = width;
+			while (end > 0 && row[end - 1] == 0) {
+				end--;
+			}
+			for(int x = 0; x < end;) {
+				int count = runLength(row, x, end);
+				if (row[x] == 0 && count >= 3) {
+					out.push_back(0);
+					out.push_back(2);
+					out.push_back((unsigned char)count);
+					out.push_back(0);
+					x += count;
+					continue;
+				}
+
+				//An absolute record needs 3 or more pixels
+				int n = 0;
+				while (x + n < end && n < 255 &&
+					   runLength(row, x + n, end) < 3) {
+					n++;
+				}
+				if (n < 3) {
+					out.push_back((unsigned char)count);
+					out.push_back(rle4 ? (unsigned char)(row[x] << 4 | row[x])
+								  : row[x]);
+					x += count;
+					continue;
+				}
+
+				out.push_back(0);
+				out.push_back((unsigned char)n);
+				size_t start = out.size();
+				for(int i = 0; i < n; i++) {
+					if (!rle4) {
+						out.push_back(row[x + i]);
+					}
+					else if (i % 2 == 0) {
+						out.push_back((unsigned char)(row[x + i] << 4));
+					}
+					else {
+						out.back() |= row[x + i];
+					}
+				}
+				if ((out.size() - start) % 2 != 0) {
+					out.push_back(0);
+				}
+				x += n;
+			}
+			out.push_back(0);
+			out.push_back(y + 1 < rows ? 0 : 1);
+		}
+		if (rows == 0) {
+			out.push_back(0);
+			out.push_back(1);
+		}
+		return out;
+	}
+
+	//Writes a V3 bitmap with the given pixel data and a gray palette of
+	//paletteSize entries, spread evenly from black to white, to filename,
+	//and waits for it to reach the disk
+	void writeBMP(const char* filename, int width, int height,
+				  int bitsPerPixel, int compression, int paletteSize,
+				  const vector<unsigned char> &data) {
+		int dataOffset = 14 + 40 + 4 * paletteSize;
+		vector<unsigned char> file;
+		file.push_back('B');
+		file.push_back('M');
+		putLittleEndian(file, dataOffset + (int)data.size(), 4);
+		putLittleEndian(file, 0, 4);
+		putLittleEndian(file, dataOffset, 4);
+		putLittleEndian(file, 40, 4);
+		putLittleEndian(file, width, 4);
+		putLittleEndian(file, height, 4);
+		putLittleEndian(file, 1, 2);
+		putLittleEndian(file, bitsPerPixel, 2);
+		putLittleEndian(file, compression, 4);
+		putLittleEndian(file, (int)data.size(), 4);
+		putLittleEndian(file, 2835, 4);
+		putLittleEndian(file, 2835, 4);
+		putLittleEndian(file, paletteSize, 4);
+		putLittleEndian(file, 0, 4);
+		for(int i = 0; i < paletteSize; i++) {
+			int level = i * 255 / (paletteSize - 1);
+			putLittleEndian(file, level | level << 8 | level << 16, 4);
+		}
+		file.insert(file.end(), data.begin(), data.end());
+
+		int fd = open(filename, O_WRONLY | O_TRUNC);
+		size_t written = 0;
+		while (written < file.size()) {
+			ssize_t n = write(fd, &file[written], file.size() - written);
+			if (n <= 0) {
+				break;
+			}
+			written += n;
+		}
+		fsync(fd);
+		close(fd);
+	}
+
+	//Asks the system to drop the cached pages of filename, so that the next
+	//read comes from the disk
+	void dropCache(const char* filename) {
+		int fd = open(filename, O_RDONLY);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+
+	/* Returns the average time, in milliseconds, that mapBMP takes to load
+	 * filename and readGray to read every row of it, from a cold page cache
+	 * if cold is true.  Sets gray to the levels read.
+	 */
+	double loadMillis(const char* filename, int repeats, bool cold,
+					  vector<float> &gray) {
+		chrono::duration<double, milli> total(0);
+		for(int i = 0; i < repeats; i++) {
+			if (cold) {
+				dropCache(filename);
+			}
+			chrono::steady_clock::time_point start =
+				chrono::steady_clock::now();
+			Image* image = mapBMP(filename);
+			gray.resize((size_t)image->width * image->height);
+			for(int y = 0; y < image->height; y++) {
+				image->readGray(y, &gray[(size_t)image->width * y]);
+			}
+			delete image;
+			total += chrono::steady_clock::now() - start;
+		}
+		return total.count() / repeats;
+	}
+
+	/* Measures how long a gray heightmap with 16 levels takes to load from a
+	 * cold page cache and a warm one, from an uncompressed 8-bit bitmap, an
+	 * RLE8 one and an RLE4 one.  The files are written to the current
+	 * directory, since a temporary directory may live in memory, where there
+	 * is no cache to drop.
+	 */
+	void benchmarkRLE(int width, int height, int repeats) {
+		//Smooth hills, so that there are runs to encode, with rough patches
+		//between runs, and a flat border at index 0 along the right and in the
+		//top rows for the encoding to skip.  Index i of the 16 levels is index
+		//17 * i of a full palette.
+		vector<unsigned char> indices((size_t)width * height);
+		vector<unsigned char> levels((size_t)width * height);
+		int stride = (width + 3) / 4 * 4;
+		vector<unsigned char> rows((size_t)stride * height, 0);
+		for(int y = 0; y < height; y++) {
+			for(int x = 0; x < width; x++) {
+				float h = sinf(x * 0.01f) * cosf(y * 0.013f);
+				int index = (int)(8 + 7.99f * h);
+				if ((x / 64 + y / 64) % 4 == 0) {
+					index += (x * 7 + y * 13) % 3 - 1;
+				}
+				if (x >= width - width / 16 || y >= height - height / 16) {
+					index = 0;
+				}
+				size_t i = (size_t)width * y + x;
+				indices[i] = (unsigned char)min(max(index, 0), 15);
+				levels[i] = (unsigned char)(17 * indices[i]);
+				rows[(size_t)stride * y + x] = levels[i];
+			}
+		}
+
+		char filename[] = "pixelbenchXXXXXX";
+		int fd = mkstemp(filename);
+		if (fd < 0) {
+			cerr << "Could not create a file to load" << endl;
+			return;
+		}
+		close(fd);
+
+		const char* names[] = {"uncompressed", "RLE8", "RLE4"};
+		vector<float> expected;
+		cout << fixed << setprecision(1);
+		for(int k = 0; k < 3; k++) {
+			size_t bytes;
+			if (k == 0) {
+				writeBMP(filename, width, height, 8, 0, 256, rows);
+				bytes = rows.size();
+			}
+			else {
+				vector<unsigned char> encoded = k == 1
+					? encodeRLE(levels, width, height, false)
+					: encodeRLE(indices, width, height, true);
+				writeBMP(filename, width, height, k == 1 ? 8 : 4, k,
+						 k == 1 ? 256 : 16, encoded);
+				bytes = encoded.size();
+			}
+
+			vector<float> gray;
+			double cold = loadMillis(filename, repeats, true, gray);
+			double warm = loadMillis(filename, repeats, false, gray);
+			cout << names[k] << ": " << (bytes >> 10) << " KB, "
+				 << cold << " ms from disk, " << warm << " ms cached";
+			if (expected.empty()) {
+				expected = gray;
+			}
+			else if (gray != expected) {
+				cout << " (levels differ from the uncompressed bitmap's)";
+			}
+			cout << endl;
+		}
+		unlink(filename);
+	}
+}
+
+//Measures how fast each pixel kernel the CPU supports converts a bitmap's
+//pixels, next to a plain copy of the same bytes, and then how fast a gray
+//heightmap of the same size loads from uncompressed and RLE bitmaps:
+//
+//    pixelbench [width] [height] [repeats]
+//
+//The default is a 4096 x 4096 bitmap, converted 20 times and loaded 5 times.
+int main(int argc, char** argv) {
+	int width = argc > 1 ? atoi(argv[1]) : 4096;
+	int height = argc > 2 ? atoi(argv[2]) : 4096;
+	int repeats = argc > 3 ? atoi(argv[3]) : 20;
+	if (width <= 0 || height <= 0 || repeats <= 0) {
+		cerr << "Usage: " << argv[0] << " [width] [height] [repeats]" << endl;
+		return 1;
+	}
+
+	size_t bytes = (size_t)width * height * 3;
+	vector<unsigned char> in(bytes);
+	vector<unsigned char> out(bytes);
+	for(size_t i = 0; i < bytes; i++) {
+		in[i] = (unsigned char)(i * 7 + i / 3);
+	}
+
+	cout << width << " x " << height << " pixels, " << (bytes >> 20)
+		 << " MB" << endl;
+	cout << "memcpy: " << (int)throughput(bytes, repeats, [&]() {
+		memcpy(&out[0], &in[0], bytes);
+	}) << " MB/s" << endl;
+
+	const char* names[] = {"scalar", "SSSE3", "AVX2"};
+	PixelKernel kernels[] = {PIXEL_KERNEL_SCALAR, PIXEL_KERNEL_SSSE3,
+							 PIXEL_KERNEL_AVX2};
+	PixelKernel best = pixelKernel();
+	vector<unsigned char> expected;
+	for(int k = 0; k < 3; k++) {
+		if (setPixelKernel(kernels[k]) != kernels[k]) {
+			cout << names[k] << ": not supported" << endl;
+			continue;
+		}
+		double speed = throughput(bytes, repeats, [&]() {
+			for(int y = 0; y < height; y++) {
+				size_t offset = (size_t)3 * width * y;
+				bgrToRgb(&in[offset], &out[offset], width);
+			}
+		});
+		cout << names[k] << ": " << (int)speed << " MB/s";
+		if (expected.empty()) {
+			expected = out;
+		}
+		else if (out != expected) {
+			cout << " (output differs from the scalar kernel's)";
+		}
+		cout << endl;
+	}
+	setPixelKernel(best);
+
+	benchmarkRLE(width, height, max(repeats / 4, 1));
+	return 0;
+}
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,251 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <math.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "terrain.h"
+#include "terrainedit.h"
+#include "vec3f.h"
+
+using namespace std;
+
+namespace {
+	//A random number in [0, 1), from a fixed sequence so that failures can be
+	//rerun
+	unsigned int seed = 12345;
+	float randomUnit() {
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) / 16777216.0f;
+	}
+
+	//Returns a random number in [lo, hi)
+	float randomIn(float lo, float hi) {
+		return lo + (hi - lo) * randomUnit();
+	}
+
+	//Finds where the ray origin + t * dir meets the triangle (a, b, c), in
+	//double precision.  Returns whether it does, and if so sets t.
+	bool hitTriangle(const Vec3f &origin, const Vec3f &dir, const Vec3f &a,
+					 const Vec3f &b, const Vec3f &c, double &t) {
+		double o[3], d[3], e1[3], e2[3], s[3];
+		for(int i = 0; i < 3; i++) {
+			o[i] = origin[i];
+			d[i] = dir[i];
+			e1[i] = (double)b[i] - a[i];
+			e2[i] = (double)c[i] - a[i];
+			s[i] = o[i] - a[i];
+		}
+		double p[3] = {d[1] * e2[2] - d[2] * e2[1],
+					   d[2] * e2[0] - d[0] * e2[2],
+					   d[0] * e2[1] - d[1] * e2[0]};
+		double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+		if (det == 0.0) {
+			return false;
+		}
+		double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+		if (u < 0.0 || u > 1.0) {
+			return false;
+		}
+		double q[3] = {s[1] * e1[2] - s[2] * e1[1],
+					   s[2] * e1[0] - s[0] * e1[2],
+					   s[0] * e1[1] - s[1] * e1[0]};
+		double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / det;
+		if (v < 0.0 || u + v > 1.0) {
+			return false;
+		}
+		t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+		return true;
+	}
+
+	/* Finds the first point where the ray origin + t * dir, for
+	 * 0 <= t <= maxT, meets one of the triangles drawn for t, by testing
+	 * every one of them.  Each cell is split along the same diagonal as the
+	 * triangle strips.  Returns whether there is one, and if so sets tHit.
+	 */
+	bool raycastEveryTriangle(Terrain* terrain, const Vec3f &origin,
+							  const Vec3f &dir, float maxT, double &tHit) {
+		bool isHit = false;
+		for(int z = 0; z + 1 < terrain->length(); z++) {
+			for(int x = 0; x + 1 < terrain->width(); x++) {
+				Vec3f a((float)x, terrain->getHeight(x, z), (float)z);
+				Vec3f b((float)x, terrain->getHeight(x, z + 1), (float)z + 1);
+				Vec3f c((float)x + 1, terrain->getHeight(x + 1, z), (float)z);
+				Vec3f d((float)x + 1, terrain->getHeight(x + 1, z + 1),
+						(float)z + 1);
+				double t;
+				if (hitTriangle(origin, dir, a, b, c, t) && t >= 0.0 &&
+					t <= maxT && (!isHit || t < tHit)) {
+					tHit = t;
+					isHit = true;
+				}
+				if (hitTriangle(origin, dir, b, c, d, t) && t >= 0.0 &&
+					t <= maxT && (!isHit || t < tHit)) {
+					tHit = t;
+					isHit = true;
+				}
+			}
+		}
+		return isHit;
+	}
+
+	/* Casts numRays random rays at terrain, looking down from above it, along
+	 * it from the sides and straight down, some of them stopping short, and
+	 * returns the number whose hit Terrain::raycast reports differently from
+	 * testing every triangle
+	 */
+	int countDifferences(Terrain* terrain, float lowest, float highest,
+						 int numRays) {
+		float w = (float)terrain->width();
+		float l = (float)terrain->length();
+		float diagonal = sqrtf(w * w + l * l + (highest - lowest) *
+							   (highest - lowest));
+		const float TOLERANCE = 1e-3f;
+		int count = 0;
+		for(int i = 0; i < numRays; i++) {
+			Vec3f origin;
+			Vec3f dir;
+			switch(i % 4) {
+				case 0:
+					//Down from above, as when picking with the mouse
+					origin = Vec3f(randomIn(-4.0f, w + 4.0f),
+								   highest + randomIn(1.0f, 20.0f),
+								   randomIn(-4.0f, l + 4.0f));
+					dir = Vec3f(randomIn(-1.0f, 1.0f), randomIn(-1.0f, -0.1f),
+								randomIn(-1.0f, 1.0f));
+					break;
+				case 1:
+					//Almost level, from anywhere around the terrain
+					origin = Vec3f(randomIn(-8.0f, w + 8.0f),
+								   randomIn(lowest, highest),
+								   randomIn(-8.0f, l + 8.0f));
+					dir = Vec3f(randomIn(-1.0f, 1.0f), randomIn(-0.1f, 0.1f),
+								randomIn(-1.0f, 1.0f));
+					break;
+				case 2:
+					//Along the x or z axis only
+					origin = Vec3f(randomIn(0.0f, w), randomIn(lowest, highest),
+								   randomIn(0.0f, l));
+					dir = randomUnit() < 0.5f
+						? Vec3f(randomIn(-1.0f, 1.0f), randomIn(-0.3f, 0.3f),
+								0.0f)
+						: Vec3f(0.0f, randomIn(-0.3f, 0.3f),
+								randomIn(-1.0f, 1.0f));
+					break;
+				default:
+					//Straight down
+					origin = Vec3f(randomIn(0.0f, w - 1.0f),
+								   highest + randomIn(0.0f, 5.0f),
+								   randomIn(0.0f, l - 1.0f));
+					dir = Vec3f(0.0f, -1.0f, 0.0f);
+					break;
+			}
+			if (dir.magnitude() == 0) {
+				continue;
+			}
+			dir = dir.normalize();
+			float maxT = randomUnit() < 0.25f ? randomIn(0.0f, diagonal)
+				: 2.0f * diagonal;
+
+			float t = 0.0f;
+			bool isHit = terrain->raycast(origin, dir, maxT, t);
+			double tExpected = 0.0;
+			bool isExpected =
+				raycastEveryTriangle(terrain, origin, dir, maxT, tExpected);
+			if (isHit != isExpected ||
+				(isHit &&
+				 fabs(t - tExpected) > TOLERANCE * max(1.0, tExpected))) {
+				count++;
+			}
+		}
+		return count;
+	}
+
+	/* Checks Terrain::raycast on a w x l terrain of random heights against
+	 * testing every triangle, first as built, and then after setHeight raises
+	 * and lowers a few cells past the old range of heights and digCrater digs
+	 * a few craters, so that the pyramid is brought up to date in place.
+	 * Returns whether they matched.
+	 */
+	bool checkRaycasts(int w, int l, int numRays) {
+		Terrain t(w, l);
+		for(int z = 0; z < l; z++) {
+			for(int x = 0; x < w; x++) {
+				t.setHeight(x, z, randomIn(-10.0f, 10.0f));
+			}
+		}
+		int differences = countDifferences(&t, -10.0f, 10.0f, numRays);
+
+		int xs[] = {0, w - 1, w / 2, w / 3};
+		int zs[] = {0, l - 1, l / 2, 2 * l / 3};
+		for(int i = 0; i < 4; i++) {
+			t.setHeight(xs[i], zs[i], i % 2 == 0 ? 25.0f : -25.0f);
+		}
+		for(int i = 0; i < 3; i++) {
+			digCrater(&t, randomIn(0.0f, (float)w), randomIn(0.0f, (float)l),
+					  randomIn(2.0f, 8.0f), randomIn(2.0f, 15.0f));
+		}
+		float lowest;
+		float highest;
+		t.heightRange(lowest, highest);
+		int editDifferences = countDifferences(&t, lowest, highest, numRays);
+
+		cout << "    " << w << " x " << l << ": ";
+		if (differences == 0 && editDifferences == 0) {
+			cout << "ok" << endl;
+			return true;
+		}
+		cout << differences << " of " << numRays << " rays differ, and "
+			 << editDifferences << " after edits" << endl;
+		return false;
+	}
+}
+
+//Checks that Terrain::raycast finds the same first hit as testing every
+//triangle of the drawn surface, on terrains of odd sizes, before and after
+//edits
+int main() {
+	const int sizes[][2] = {
+		{1, 1}, {2, 2}, {1, 9}, {7, 3}, {33, 17}, {64, 64}, {129, 77}
+	};
+	bool ok = true;
+	for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		ok = checkRaycasts(sizes[i][0], sizes[i][1], 2000) && ok;
+	}
+	cout << (ok ? "ok" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
+
+
+
+
+
+
+
+
+
+
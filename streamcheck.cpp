@@ -0,0 +1,167 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <vector>
+
+#include "terrain.h"
+#include "terrainstream.h"
+
+using namespace std;
+
+namespace {
+	//Returns the anonymous memory of the process, in bytes
+	size_t anonymousBytes() {
+		FILE* status = fopen("/proc/self/status", "r");
+		if (status == NULL) {
+			return 0;
+		}
+		char line[256];
+		long kilobytes = 0;
+		while (fgets(line, sizeof(line), status) != NULL) {
+			if (strncmp(line, "RssAnon:", 8) == 0) {
+				kilobytes = atol(line + 8);
+			}
+		}
+		fclose(status);
+		return (size_t)kilobytes << 10;
+	}
+
+	//Saves a size x size terrain with the given height format to filename
+	void saveHills(int size, HeightFormat heightFormat, const char* filename) {
+		Terrain* t = heightFormat == HEIGHTS_FLOAT
+			? new Terrain(size, size, NORMALS_OCT16, LAYOUT_TILED)
+			: new Terrain(size, size, -10.0f, 10.0f, NORMALS_OCT16,
+						  LAYOUT_TILED);
+		t->fillHeights([size](int z, float* row) {
+			for(int x = 0; x < size; x++) {
+				row[x] = 5.0f * sinf(x * 0.05f) * cosf(z * 0.07f) +
+					3.0f * sinf((x + z) * 0.013f);
+			}
+		});
+		saveTerrain(t, filename);
+		delete t;
+	}
+
+	/* Maps filename with a budget of budgetBytes, reads the heights and the
+	 * data derived from them a tile at a time, as the game's chunks do, and
+	 * checks that the blocks in memory, and the anonymous memory the process
+	 * gained, stay within the budget.  Returns whether they did.
+	 */
+	bool checkBudget(const char* filename, size_t budgetBytes,
+					 NormalFormat normalFormat) {
+		Terrain* t = mapTerrain(filename, budgetBytes, normalFormat);
+		//Light from the side, so that the shadows have to be swept
+		t->setLightDirection(Vec3f(-0.5f, 0.8f, 0.1f));
+		const int TILE_SIZE = Terrain::TILE_SIZE;
+		vector<float> heights(TILE_SIZE);
+		vector<Vec3f> normals(TILE_SIZE);
+		vector<float> occlusion(TILE_SIZE);
+		vector<float> shadows(TILE_SIZE);
+		size_t baseBytes = anonymousBytes();
+		size_t peakBytes = 0;
+		size_t peakResident = 0;
+		for(int z0 = 0; z0 < t->length(); z0 += TILE_SIZE) {
+			for(int x0 = 0; x0 < t->width(); x0 += TILE_SIZE) {
+				int x1 = min(x0 + TILE_SIZE, t->width());
+				for(int z = z0; z < min(z0 + TILE_SIZE, t->length()); z++) {
+					t->readHeights(z, x0, x1, &heights[0]);
+					t->readNormals(z, x0, x1, &normals[0]);
+					t->readAmbientOcclusion(z, x0, x1, &occlusion[0]);
+					t->readShadows(z, x0, x1, &shadows[0]);
+					float dhdx;
+					float dhdz;
+					t->getGradient(x0 + 0.5f, z + 0.5f, dhdx, dhdz);
+				}
+			}
+			peakBytes = max(peakBytes, anonymousBytes() - baseBytes);
+			peakResident = max(peakResident, t->getStream()->residentBytes());
+		}
+		delete t;
+
+		bool ok = peakResident <= budgetBytes && peakBytes <= budgetBytes;
+		cout << "    " << (peakResident >> 10) << " KB of blocks, anonymous "
+			 << "memory up " << (peakBytes >> 10) << " KB"
+			 << (ok ? "" : " -- over budget") << endl;
+		return ok;
+	}
+}
+
+//Checks that a mapped terrain keeps to its memory budget while all of it is
+//read, for each pair of height and normal formats:
+//
+//    streamcheck [size] [budgetKB]
+//
+//The default is a 2048 x 2048 terrain with a 2048 KB budget, which is less
+//than its normals take in any format.  Exits with 1 if any pair goes over.
+int main(int argc, char** argv) {
+	int size = argc > 1 ? atoi(argv[1]) : 2048;
+	size_t budgetBytes = (size_t)(argc > 2 ? atoi(argv[2]) : 2048) << 10;
+	if (size <= 0 || budgetBytes == 0) {
+		cerr << "Usage: " << argv[0] << " [size] [budgetKB]" << endl;
+		return 1;
+	}
+
+	char filename[] = "/tmp/streamcheckXXXXXX";
+	int fd = mkstemp(filename);
+	if (fd < 0) {
+		cerr << "Could not create a temporary file" << endl;
+		return 1;
+	}
+	close(fd);
+
+	const char* heightNames[] = {"float", "16-bit"};
+	HeightFormat heightFormats[] = {HEIGHTS_FLOAT, HEIGHTS_UINT16};
+	const char* normalNames[] = {"float", "oct32", "oct16"};
+	NormalFormat normalFormats[] = {NORMALS_FLOAT, NORMALS_OCT32,
+									NORMALS_OCT16};
+	bool ok = true;
+	for(int h = 0; h < 2; h++) {
+		saveHills(size, heightFormats[h], filename);
+		for(int n = 0; n < 3; n++) {
+			cout << heightNames[h] << " heights, " << normalNames[n]
+				 << " normals:" << endl;
+			ok = checkBudget(filename, budgetBytes, normalFormats[n]) && ok;
+		}
+	}
+	unlink(filename);
+	cout << (ok ? "ok" : "FAILED") << endl;
+	return ok ? 0 : 1;
+}
+
+
+
+
+
+
+
+
+
+
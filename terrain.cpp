@@ -0,0 +1,882 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include "arena.h"
+#include "heightpyramid.h"
+#include "horizonbake.h"
+#include "imageloader.h"
+#include "normalkernels.h"
+#include "terrain.h"
+#include "terrainstream.h"
+#include "threadpool.h"
+
+using namespace std;
+
+namespace {
+	//The alignment of the height and normal buffers, in bytes
+	const int BUFFER_ALIGNMENT = 64;
+
+	//Allocates size bytes aligned to BUFFER_ALIGNMENT
+	void* alignedAlloc(size_t size) {
+		void* p = NULL;
+		if (posix_memalign(&p, BUFFER_ALIGNMENT, size) != 0) {
+			assert(!"Out of memory");
+			return NULL;
+		}
+		return p;
+	}
+
+	//The fewest cells worth handing to another thread
+	const int MIN_BAND_CELLS = 16384;
+
+	//Sets out[i] to in[i] * scale + offset for 0 <= i < n
+	void dequantizeHeights(const unsigned short* in, int n, float scale,
+						   float offset, float* out) {
+		int i = 0;
+#ifdef __SSE2__
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 scale4 = _mm_set1_ps(scale);
+		const __m128 offset4 = _mm_set1_ps(offset);
+		for(; i + 8 <= n; i += 8) {
+			__m128i levels = _mm_loadu_si128((const __m128i*)(in + i));
+			__m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(levels, zero));
+			__m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(levels, zero));
+			_mm_storeu_ps(out + i,
+						  _mm_add_ps(_mm_mul_ps(lo, scale4), offset4));
+			_mm_storeu_ps(out + i + 4,
+						  _mm_add_ps(_mm_mul_ps(hi, scale4), offset4));
+		}
+#endif
+		for(; i < n; i++) {
+			out[i] = in[i] * scale + offset;
+		}
+	}
+
+	//Returns the Z-order position of (x, z), for x and z below 65536
+	unsigned int mortonCode(int x, int z) {
+		unsigned int code = 0;
+		for(int bit = 0; bit < 16; bit++) {
+			code |= ((unsigned int)(x >> bit) & 1) << (2 * bit);
+			code |= ((unsigned int)(z >> bit) & 1) << (2 * bit + 1);
+		}
+		return code;
+	}
+
+	//Rounds w up so that a row of w floats fills whole cache lines
+	int paddedStride(int w) {
+		const int perLine = BUFFER_ALIGNMENT / sizeof(float);
+		return (w + perLine - 1) / perLine * perLine;
+	}
+
+	//Returns how lit a cell of the given height is, as 0 - 255, when the
+	//shadow's edge was at edge at the last step of its line, and moves edge
+	//on to the cell
+	unsigned char shade(float height, float &edge, float drop) {
+		edge -= drop;
+		float lit = (height - edge) / SHADOW_SOFTNESS + 1.0f;
+		lit = lit < 0.0f ? 0.0f : (lit > 1.0f ? 1.0f : lit);
+		edge = max(edge, height);
+		return (unsigned char)(lit * 255.0f + 0.5f);
+	}
+}
+
+const unsigned short Terrain::tileSpread[Terrain::TILE_SIZE] = {
+	0x000, 0x001, 0x004, 0x005, 0x010, 0x011, 0x014, 0x015,
+	0x040, 0x041, 0x044, 0x045, 0x050, 0x051, 0x054, 0x055,
+	0x100, 0x101, 0x104, 0x105, 0x110, 0x111, 0x114, 0x115,
+	0x140, 0x141, 0x144, 0x145, 0x150, 0x151, 0x154, 0x155
+};
+
+TerrainRect::TerrainRect() : x0(0), z0(0), x1(0), z1(0) {
+
+}
+
+TerrainRect::TerrainRect(int x0_, int z0_, int x1_, int z1_) :
+	x0(x0_), z0(z0_), x1(x1_), z1(z1_) {
+
+}
+
+void TerrainRect::include(int x, int z) {
+	include(TerrainRect(x, z, x + 1, z + 1));
+}
+
+void TerrainRect::include(const TerrainRect &other) {
+	if (other.isEmpty()) {
+		return;
+	}
+	if (isEmpty()) {
+		*this = other;
+		return;
+	}
+	x0 = min(x0, other.x0);
+	z0 = min(z0, other.z0);
+	x1 = max(x1, other.x1);
+	z1 = max(z1, other.z1);
+}
+
+TerrainRect TerrainRect::expanded(int border) const {
+	if (isEmpty()) {
+		return *this;
+	}
+	return TerrainRect(x0 - border, z0 - border, x1 + border, z1 + border);
+}
+
+TerrainRect TerrainRect::clipped(const TerrainRect &other) const {
+	TerrainRect r(max(x0, other.x0), max(z0, other.z0),
+				  min(x1, other.x1), min(z1, other.z1));
+	if (r.isEmpty()) {
+		return TerrainRect();
+	}
+	return r;
+}
+
+Terrain::Terrain(int w2, int l2, NormalFormat normalFormat2,
+				 TerrainLayout layout2, Arena* arena2) {
+	init(w2, l2, normalFormat2, layout2, arena2);
+	hs = (float*)allocate(sizeof(float) * cellCount);
+	allocateNormals();
+}
+
+Terrain::Terrain(int w2, int l2, float minHeight, float maxHeight,
+				 NormalFormat normalFormat2, TerrainLayout layout2,
+				 Arena* arena2) {
+	init(w2, l2, normalFormat2, layout2, arena2);
+	qhs = (unsigned short*)allocate(sizeof(unsigned short) * cellCount);
+	heightOffset = minHeight;
+	heightScale = (maxHeight - minHeight) / 65535.0f;
+	if (heightScale <= 0.0f) {
+		heightScale = 1.0f;
+	}
+	allocateNormals();
+}
+
+void Terrain::init(int w2, int l2, NormalFormat normalFormat2,
+				   TerrainLayout layout2, Arena* arena2) {
+	w = w2;
+	l = l2;
+	stride = paddedStride(w);
+	arena = arena2;
+
+	layout = layout2;
+	tilesX = 0;
+	tileBase = NULL;
+	if (layout == LAYOUT_ROWS) {
+		cellCount = (size_t)stride * l;
+	}
+	else {
+		//Number the tiles in Z-order, skipping the codes of the tiles that a
+		//terrain which isn't a power-of-two square doesn't have
+		tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+		int tilesZ = (l + TILE_SIZE - 1) / TILE_SIZE;
+		vector<pair<unsigned int, int> > order;
+		for(int tz = 0; tz < tilesZ; tz++) {
+			for(int tx = 0; tx < tilesX; tx++) {
+				order.push_back(make_pair(mortonCode(tx, tz),
+										  tz * tilesX + tx));
+			}
+		}
+		sort(order.begin(), order.end());
+
+		tileBase = (int*)allocate(sizeof(int) * order.size());
+		for(size_t i = 0; i < order.size(); i++) {
+			tileBase[order[i].second] = (int)i * TILE_SIZE * TILE_SIZE;
+		}
+		cellCount = order.size() * TILE_SIZE * TILE_SIZE;
+	}
+
+	hs = NULL;
+	qhs = NULL;
+	heightScale = 1.0f;
+	heightOffset = 0.0f;
+	isHeightRangeKnown = false;
+	lowestHeight = 0.0f;
+	highestHeight = 0.0f;
+
+	normalFormat = normalFormat2;
+	normals = NULL;
+	octNormals32 = NULL;
+	octNormals16 = NULL;
+
+	dirty = bounds();
+	pool = NULL;
+	pyramid = NULL;
+	stream = NULL;
+	occlusion = NULL;
+	shadows = NULL;
+	gradients = NULL;
+	toLight = Vec3f(0.0f, 1.0f, 0.0f);
+	lightChanged = true;
+}
+
+void Terrain::allocateNormals() {
+	switch(normalFormat) {
+		case NORMALS_FLOAT:
+			normals = (Vec3f*)allocate(sizeof(Vec3f) * cellCount);
+			break;
+		case NORMALS_OCT32:
+			octNormals32 = (unsigned int*)allocate(
+				sizeof(unsigned int) * cellCount);
+			break;
+		case NORMALS_OCT16:
+			octNormals16 = (unsigned short*)allocate(
+				sizeof(unsigned short) * cellCount);
+			break;
+	}
+}
+
+void* Terrain::allocate(size_t size) {
+	if (arena != NULL) {
+		return arena->allocate(size, BUFFER_ALIGNMENT);
+	}
+	return alignedAlloc(size);
+}
+
+void Terrain::release(void* p) {
+	if (arena == NULL) {
+		free(p);
+	}
+}
+
+Terrain::~Terrain() {
+	if (stream != NULL) {
+		//The buffers belong to the stream's mappings
+		delete stream;
+	}
+	else {
+		release(hs);
+		release(qhs);
+		release(normals);
+		release(octNormals32);
+		release(octNormals16);
+		release(occlusion);
+		release(shadows);
+		release(gradients);
+	}
+	release(tileBase);
+	delete pyramid;
+}
+
+void Terrain::computeNormals() {
+	if (dirty.isEmpty()) {
+		return;
+	}
+
+	//A height feeds the rough normals of the cells next to it, and each rough
+	//normal feeds the smoothed normals of the cells next to it
+	TerrainRect rect = dirty.expanded(2).clipped(bounds());
+	dirty = TerrainRect();
+	if (stream != NULL) {
+		stream->invalidateDerived(rect, DERIVED_NORMALS);
+	}
+	else {
+		computeNormals(rect);
+	}
+}
+
+void Terrain::touchStream(int x, int z, bool write) {
+	stream->touch(tileId(x, z), write);
+}
+
+void Terrain::prefetch(float x, float z, float dx, float dz) {
+	if (stream != NULL) {
+		stream->prefetch(x, z, dx, dz);
+	}
+}
+
+void Terrain::ensureDerived(int x, int z, Derived kind) {
+	int tile = tileId(x, z);
+	stream->touch(tile, false);
+	if (stream->hasDerived(tile, kind)) {
+		return;
+	}
+
+	//Mark the data as present first, since computing it reads the heights
+	//of this tile too
+	vector<int> tiles = stream->markDerived(tile, kind);
+	for(size_t i = 0; i < tiles.size(); i++) {
+		int tx = tiles[i] % tilesX * TILE_SIZE;
+		int tz = tiles[i] / tilesX * TILE_SIZE;
+		TerrainRect rect(tx, tz, min(tx + TILE_SIZE, w),
+						 min(tz + TILE_SIZE, l));
+		switch(kind) {
+			case DERIVED_NORMALS:
+				computeNormals(rect);
+				break;
+			case DERIVED_OCCLUSION:
+				computeAmbientOcclusion(rect);
+				break;
+			case DERIVED_SHADOWS:
+				computeShadows(rect);
+				break;
+			case DERIVED_GRADIENTS:
+				computeGradients(rect);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+template<class F>
+void Terrain::forEachBand(int z0, int z1, int rowCells, const F &f,
+						  int minRows) {
+	//Mapped terrains page tiles in and out on the calling thread only
+	if (pool == NULL || stream != NULL) {
+		f(z0, z1);
+		return;
+	}
+
+	pool->parallelFor(z0, z1,
+					  max(minRows, MIN_BAND_CELLS / max(rowCells, 1)), f);
+}
+
+void Terrain::computeNormals(const TerrainRect &rect) {
+	//The smoothing reads the rough normals of rect and a one-cell border
+	//around it
+	int roughX0 = max(rect.x0 - 1, 0);
+	int roughX1 = min(rect.x1 + 1, w);
+	int roughStride = paddedStride(roughX1 - roughX0);
+
+	forEachBand(rect.z0, rect.z1, roughX1 - roughX0, [&](int z0, int z1) {
+		//A rolling window of the rough normals of rows z - 1, z and z + 1,
+		//with row z kept in rows[(z - z0 + 1) % 3]
+		float* window = (float*)alignedAlloc(sizeof(float) * 9 * roughStride);
+		//The smoothed normals of a row, before they are stored
+		bool direct = normalFormat == NORMALS_FLOAT && layout == LAYOUT_ROWS;
+		Vec3f* encodeRow = NULL;
+		if (!direct) {
+			encodeRow = (Vec3f*)alignedAlloc(sizeof(Vec3f) * roughStride);
+		}
+		NormalRowSoA rows[3];
+		for(int i = 0; i < 3; i++) {
+			float* row2 = window + 3 * i * roughStride - roughX0;
+			rows[i].x = row2;
+			rows[i].y = row2 + roughStride;
+			rows[i].z = row2 + 2 * roughStride;
+		}
+
+		//Heights that aren't stored as float rows are read through a ring of
+		//four copied rows, enough for the three rows each rough normal reads
+		bool heightRows = hs != NULL && layout == LAYOUT_ROWS;
+		float* heightRing = NULL;
+		int ringRows[4] = {-1, -1, -1, -1};
+		if (!heightRows) {
+			heightRing = (float*)alignedAlloc(sizeof(float) * 4 * stride);
+		}
+		int heightX0 = max(roughX0 - 1, 0);
+		int heightX1 = min(roughX1 + 1, w);
+
+		//Returns the heights of row z
+		auto heights = [&](int z) -> const float* {
+			if (heightRows) {
+				return hs + z * stride;
+			}
+			int slot = z & 3;
+			float* row = heightRing + slot * stride;
+			if (ringRows[slot] != z) {
+				readHeights(z, heightX0, heightX1, row + heightX0);
+				ringRows[slot] = z;
+			}
+			return row;
+		};
+
+		//Computes the rough version of the normals of row z
+		auto computeRough = [&](int z) {
+			roughNormalsRow(z > 0 ? heights(z - 1) : NULL,
+							heights(z),
+							z < l - 1 ? heights(z + 1) : NULL,
+							w, roughX0, roughX1, rows[(z - z0 + 1) % 3]);
+		};
+
+		if (z0 > 0) {
+			computeRough(z0 - 1);
+		}
+		computeRough(z0);
+		for(int z = z0; z < z1; z++) {
+			if (z < l - 1) {
+				computeRough(z + 1);
+			}
+
+			//Smooth out the normals
+			Vec3f* out = direct ? normals + z * stride : encodeRow - rect.x0;
+			smoothNormalsRow(z > 0 ? &rows[(z - z0) % 3] : NULL,
+							 rows[(z - z0 + 1) % 3],
+							 z < l - 1 ? &rows[(z - z0 + 2) % 3] : NULL,
+							 w, rect.x0, rect.x1, out);
+			if (!direct) {
+				storeNormals(z, rect.x0, rect.x1, encodeRow);
+			}
+		}
+
+		free(window);
+		free(encodeRow);
+		free(heightRing);
+	});
+}
+
+bool Terrain::raycast(const Vec3f &origin, const Vec3f &dir, float maxT,
+					  float &t) {
+	if (pyramid == NULL) {
+		pyramid = new HeightPyramid(this);
+	}
+	else if (!pyramidDirty.isEmpty()) {
+		pyramid->update(this, pyramidDirty);
+	}
+	pyramidDirty = TerrainRect();
+	return pyramid->raycast(this, origin, dir, maxT, t);
+}
+
+void Terrain::computeAmbientOcclusion() {
+	if (occlusion == NULL) {
+		occlusion = (unsigned char*)allocate(cellCount);
+		occlusionDirty = bounds();
+	}
+
+	//A height lies on the horizon of the cells up to OCCLUSION_RADIUS away
+	TerrainRect rect =
+		occlusionDirty.expanded(OCCLUSION_RADIUS).clipped(bounds());
+	occlusionDirty = TerrainRect();
+	if (stream != NULL) {
+		stream->invalidateDerived(rect, DERIVED_OCCLUSION);
+	}
+	else if (!rect.isEmpty()) {
+		computeAmbientOcclusion(rect);
+	}
+}
+
+void Terrain::computeAmbientOcclusion(const TerrainRect &rect) {
+	int windowX0 = max(rect.x0 - OCCLUSION_RADIUS, 0);
+	int windowX1 = min(rect.x1 + OCCLUSION_RADIUS, w);
+	int windowStride = windowX1 - windowX0;
+	//Each band copies the heights OCCLUSION_RADIUS rows around it, so keep
+	//bands long enough that this is at most double the work
+	forEachBand(rect.z0, rect.z1, rect.x1 - rect.x0, [&](int z0, int z1) {
+		HeightWindow window;
+		window.x0 = windowX0;
+		window.x1 = windowX1;
+		window.z0 = max(z0 - OCCLUSION_RADIUS, 0);
+		window.z1 = min(z1 + OCCLUSION_RADIUS, l);
+		window.stride = windowStride;
+		vector<float> heights((size_t)(window.z1 - window.z0) * windowStride);
+		for(int z = window.z0; z < window.z1; z++) {
+			readHeights(z, windowX0, windowX1,
+						&heights[(size_t)(z - window.z0) * windowStride]);
+		}
+		window.heights = &heights[0];
+
+		vector<unsigned char> row(rect.x1 - rect.x0);
+		for(int z = z0; z < z1; z++) {
+			occlusionRow(window, z, rect.x0, rect.x1, &row[0]);
+			for(int x = rect.x0; x < rect.x1; x++) {
+				occlusion[cellIndex(x, z)] = row[x - rect.x0];
+			}
+		}
+	}, 2 * OCCLUSION_RADIUS);
+}
+
+void Terrain::readAmbientOcclusion(int z, int x0, int x1, float* out) {
+	if (occlusion == NULL || !occlusionDirty.isEmpty()) {
+		computeAmbientOcclusion();
+	}
+	for(int xs = x0; xs < x1;) {
+		int xe = x1;
+		if (stream != NULL) {
+			//Go a tile at a time, as readNormals does
+			xe = min(x1, xs - xs % TILE_SIZE + TILE_SIZE);
+			ensureDerived(xs, z, DERIVED_OCCLUSION);
+		}
+		for(int x = xs; x < xe; x++) {
+			out[x - x0] = occlusion[cellIndex(x, z)] / 255.0f;
+		}
+		xs = xe;
+	}
+}
+
+void Terrain::setLightDirection(const Vec3f &toLight2) {
+	if (toLight2[0] != toLight[0] || toLight2[1] != toLight[1] ||
+		toLight2[2] != toLight[2]) {
+		toLight = toLight2;
+		lightChanged = true;
+	}
+}
+
+void Terrain::computeShadows() {
+	if (shadows == NULL) {
+		shadows = (unsigned char*)allocate(cellCount);
+		lightChanged = true;
+	}
+
+	if (stream != NULL) {
+		//The cells a changed height shades are swept again when they are next
+		//used
+		TerrainRect rect = lightChanged ? bounds() : shadowsCastBy(shadowDirty);
+		stream->invalidateDerived(rect, DERIVED_SHADOWS);
+		lightChanged = false;
+		shadowDirty = TerrainRect();
+		return;
+	}
+
+	ShadowSweep sweep(w, l, toLight);
+	if (sweep.isAllLit() || sweep.isAllShadowed()) {
+		memset(shadows, sweep.isAllLit() ? 255 : 0, cellCount);
+		lightChanged = false;
+		shadowDirty = TerrainRect();
+		return;
+	}
+
+	//A height shades the cells further along its line from the sun
+	int k0 = sweep.firstLine();
+	int k1 = sweep.endLine();
+	if (!lightChanged) {
+		if (shadowDirty.isEmpty()) {
+			return;
+		}
+		sweep.linesThrough(shadowDirty, k0, k1);
+	}
+	lightChanged = false;
+	shadowDirty = TerrainRect();
+
+	forEachBand(k0, k1, sweep.steps(), [&](int lineBegin, int lineEnd) {
+		//The height of the shadow's edge along each line, at its last cell
+		vector<float> edges(lineEnd - lineBegin, -FLT_MAX);
+		for(int i = 0; i < sweep.steps(); i++) {
+			for(int k = lineBegin; k < lineEnd; k++) {
+				int x;
+				int z;
+				if (!sweep.cell(k, i, x, z)) {
+					continue;
+				}
+				shadows[cellIndex(x, z)] = shade(getHeight(x, z),
+												 edges[k - lineBegin],
+												 sweep.drop());
+			}
+		}
+	});
+}
+
+void Terrain::computeShadows(const TerrainRect &rect) {
+	ShadowSweep sweep(w, l, toLight);
+	if (sweep.isAllLit() || sweep.isAllShadowed()) {
+		for(int z = rect.z0; z < rect.z1; z++) {
+			for(int x = rect.x0; x < rect.x1; x++) {
+				shadows[cellIndex(x, z)] = sweep.isAllLit() ? 255 : 0;
+			}
+		}
+		return;
+	}
+
+	float lowest;
+	float highest;
+	heightRange(lowest, highest);
+	int reach = sweep.reach(highest - lowest);
+	int k0;
+	int k1;
+	int i0;
+	int i1;
+	sweep.linesThrough(rect, k0, k1);
+	sweep.stepsThrough(rect, i0, i1);
+	for(int k = k0; k < k1; k++) {
+		float edge = -FLT_MAX;
+		for(int i = max(i0 - reach, 0); i < i1; i++) {
+			int x;
+			int z;
+			if (!sweep.cell(k, i, x, z)) {
+				continue;
+			}
+			unsigned char lit = shade(getHeight(x, z), edge, sweep.drop());
+			if (x >= rect.x0 && x < rect.x1 && z >= rect.z0 && z < rect.z1) {
+				shadows[cellIndex(x, z)] = lit;
+			}
+		}
+	}
+}
+
+TerrainRect Terrain::shadowsCastBy(const TerrainRect &rect) {
+	if (rect.isEmpty()) {
+		return rect;
+	}
+	float lowest;
+	float highest;
+	heightRange(lowest, highest);
+	ShadowSweep sweep(w, l, toLight);
+	return sweep.shaded(rect, sweep.reach(highest - lowest)).clipped(bounds());
+}
+
+void Terrain::readShadows(int z, int x0, int x1, float* out) {
+	if (shadows == NULL || lightChanged || !shadowDirty.isEmpty()) {
+		computeShadows();
+	}
+	for(int xs = x0; xs < x1;) {
+		int xe = x1;
+		if (stream != NULL) {
+			xe = min(x1, xs - xs % TILE_SIZE + TILE_SIZE);
+			ensureDerived(xs, z, DERIVED_SHADOWS);
+		}
+		for(int x = xs; x < xe; x++) {
+			out[x - x0] = shadows[cellIndex(x, z)] / 255.0f;
+		}
+		xs = xe;
+	}
+}
+
+void Terrain::computeGradients() {
+	if (gradients == NULL) {
+		gradients = (unsigned int*)allocate(sizeof(unsigned int) * cellCount);
+		gradientDirty = bounds();
+	}
+
+	//The slope of a cell is taken from the heights on either side of it
+	TerrainRect rect = gradientDirty.expanded(1).clipped(bounds());
+	gradientDirty = TerrainRect();
+	if (stream != NULL) {
+		stream->invalidateDerived(rect, DERIVED_GRADIENTS);
+	}
+	else if (!rect.isEmpty()) {
+		computeGradients(rect);
+	}
+}
+
+void Terrain::computeGradients(const TerrainRect &rect) {
+	int readX0 = max(rect.x0 - 1, 0);
+	int readX1 = min(rect.x1 + 1, w);
+	int readWidth = readX1 - readX0;
+	forEachBand(rect.z0, rect.z1, rect.x1 - rect.x0, [&](int z0, int z1) {
+		int readZ0 = max(z0 - 1, 0);
+		int readZ1 = min(z1 + 1, l);
+		vector<float> heights((size_t)(readZ1 - readZ0) * readWidth);
+		for(int z = readZ0; z < readZ1; z++) {
+			readHeights(z, readX0, readX1,
+						&heights[(size_t)(z - readZ0) * readWidth]);
+		}
+
+		for(int z = z0; z < z1; z++) {
+			//Central differences, or one-sided ones at the edges
+			int above = max(z - 1, 0);
+			int below = min(z + 1, l - 1);
+			const float* row = &heights[(size_t)(z - readZ0) * readWidth];
+			const float* rowAbove =
+				&heights[(size_t)(above - readZ0) * readWidth];
+			const float* rowBelow =
+				&heights[(size_t)(below - readZ0) * readWidth];
+			float zScale =
+				below > above ? GRADIENT_SCALE / (float)(below - above) : 0.0f;
+			for(int x = rect.x0; x < rect.x1; x++) {
+				int left = max(x - 1, 0);
+				int right = min(x + 1, w - 1);
+				float xScale =
+					right > left ? GRADIENT_SCALE / (float)(right - left) : 0.0f;
+				float dx = (row[right - readX0] - row[left - readX0]) * xScale;
+				float dz =
+					(rowBelow[x - readX0] - rowAbove[x - readX0]) * zScale;
+				dx = max(-32767.0f, min(dx, 32767.0f));
+				dz = max(-32767.0f, min(dz, 32767.0f));
+				gradients[cellIndex(x, z)] =
+					(unsigned int)(unsigned short)(short)lrintf(dx) |
+					((unsigned int)(unsigned short)(short)lrintf(dz) << 16);
+			}
+		}
+	});
+}
+
+void Terrain::storeNormals(int z, int x0, int x1, const Vec3f* in) {
+	switch(normalFormat) {
+		case NORMALS_FLOAT:
+			for(int x = x0; x < x1; x++) {
+				normals[cellIndex(x, z)] = in[x - x0];
+			}
+			break;
+		case NORMALS_OCT32:
+			for(int x = x0; x < x1; x++) {
+				octNormals32[cellIndex(x, z)] = encodeOct32(in[x - x0]);
+			}
+			break;
+		case NORMALS_OCT16:
+			for(int x = x0; x < x1; x++) {
+				octNormals16[cellIndex(x, z)] = encodeOct16(in[x - x0]);
+			}
+			break;
+	}
+}
+
+void Terrain::readHeights(int z, int x0, int x1, float* out) {
+	if (layout == LAYOUT_ROWS) {
+		if (hs != NULL) {
+			memcpy(out, hs + z * stride + x0, sizeof(float) * (x1 - x0));
+		}
+		else {
+			dequantizeHeights(qhs + z * stride + x0, x1 - x0, heightScale,
+							  heightOffset, out);
+		}
+		return;
+	}
+
+	for(int x = x0; x < x1; x++) {
+		if (stream != NULL) {
+			touchStream(x, z, false);
+		}
+		int i = cellIndex(x, z);
+		out[x - x0] = hs != NULL ? hs[i] : dequantizeHeight(qhs[i]);
+	}
+}
+
+void Terrain::writeHeights(int z, int x0, int x1, const float* in) {
+	storeHeights(z, x0, x1, in);
+	for(int x = x0; x < x1; x++) {
+		includeHeight(in[x - x0]);
+	}
+	markChanged(TerrainRect(x0, z, x1, z + 1));
+}
+
+void Terrain::heightRange(float &lowest, float &highest) {
+	if (!isHeightRangeKnown) {
+		vector<float> row(w);
+		lowestHeight = FLT_MAX;
+		highestHeight = -FLT_MAX;
+		for(int z = 0; z < l; z++) {
+			readHeights(z, 0, w, &row[0]);
+			for(int x = 0; x < w; x++) {
+				includeHeight(row[x]);
+			}
+		}
+		if (lowestHeight > highestHeight) {
+			lowestHeight = highestHeight = 0.0f;
+		}
+		isHeightRangeKnown = true;
+	}
+	lowest = lowestHeight;
+	highest = highestHeight;
+}
+
+void Terrain::fillHeights(const function<void(int, float*)> &f) {
+	forEachBand(0, l, w, [this, &f](int z0, int z1) {
+		vector<float> row(w);
+		for(int z = z0; z < z1; z++) {
+			f(z, &row[0]);
+			storeHeights(z, 0, w, &row[0]);
+		}
+	});
+	invalidateNormals();
+}
+
+void Terrain::storeHeights(int z, int x0, int x1, const float* in) {
+	if (stream != NULL) {
+		for(int x = x0; x < x1; x += TILE_SIZE - x % TILE_SIZE) {
+			touchStream(x, z, true);
+		}
+	}
+	if (hs != NULL) {
+		for(int x = x0; x < x1; x++) {
+			hs[cellIndex(x, z)] = in[x - x0];
+		}
+	}
+	else {
+		for(int x = x0; x < x1; x++) {
+			qhs[cellIndex(x, z)] = quantizeHeight(in[x - x0]);
+		}
+	}
+}
+
+void Terrain::readNormals(int z, int x0, int x1, Vec3f* out) {
+	if (!dirty.isEmpty()) {
+		computeNormals();
+	}
+	for(int xs = x0; xs < x1;) {
+		int xe = x1;
+		if (stream != NULL) {
+			//Go a tile at a time, since bringing in the normals of one tile
+			//may page out those of another
+			xe = min(x1, xs - xs % TILE_SIZE + TILE_SIZE);
+			ensureDerived(xs, z, DERIVED_NORMALS);
+		}
+
+		switch(normalFormat) {
+			case NORMALS_FLOAT:
+				for(int x = xs; x < xe; x++) {
+					out[x - x0] = normals[cellIndex(x, z)];
+				}
+				break;
+			case NORMALS_OCT32:
+				for(int x = xs; x < xe; x++) {
+					out[x - x0] = decodeOct32(octNormals32[cellIndex(x, z)]);
+				}
+				break;
+			case NORMALS_OCT16:
+				for(int x = xs; x < xe; x++) {
+					out[x - x0] = decodeOct16(octNormals16[cellIndex(x, z)]);
+				}
+				break;
+		}
+		xs = xe;
+	}
+}
+
+Terrain* loadTerrain(const char* filename, float height, ThreadPool* pool,
+					 NormalFormat normalFormat, HeightFormat heightFormat,
+					 TerrainLayout layout, Arena* arena) {
+	Image* image = mapBMP(filename, pool);
+	Terrain* t;
+	if (heightFormat == HEIGHTS_UINT16) {
+		t = new Terrain(image->width, image->height, -height / 2, height / 2,
+						normalFormat, layout, arena);
+	}
+	else {
+		t = new Terrain(image->width, image->height, normalFormat, layout,
+						arena);
+	}
+	t->setThreadPool(pool);
+	//Take the heights straight from the file's pixels, a band of rows per
+	//thread
+	int w = image->width;
+	t->fillHeights([image, w, height](int z, float* row) {
+		image->readGray(z, row);
+		for(int x = 0; x < w; x++) {
+			row[x] = height * (row[x] - 0.5f);
+		}
+	});
+
+	delete image;
+	t->computeNormals();
+	return t;
+}
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,571 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef TERRAIN_H_INCLUDED
+#define TERRAIN_H_INCLUDED
+
+#include <assert.h>
+
+#include <functional>
+
+#include "octnormal.h"
+#include "vec3f.h"
+
+class Arena;
+class HeightPyramid;
+class TerrainStream;
+class ThreadPool;
+
+//The ways a terrain can store its heights
+enum HeightFormat {
+	HEIGHTS_FLOAT, //A float per cell
+	HEIGHTS_UINT16 //A 16-bit fraction of the terrain's height range per cell
+};
+
+//The orders a terrain can store its cells in
+enum TerrainLayout {
+	LAYOUT_ROWS, //Row by row
+	LAYOUT_TILED //In square tiles, each stored in Z-order (Morton order), with
+	             //the tiles themselves also in Z-order
+};
+
+//The ways a terrain can store its normals
+enum NormalFormat {
+	NORMALS_FLOAT, //A Vec3f per cell
+	NORMALS_OCT32, //A 32-bit octahedral encoding per cell; see octnormal.h
+	NORMALS_OCT16 //A 16-bit octahedral encoding per cell
+};
+
+//A rectangle of terrain cells, covering x0 <= x < x1 and z0 <= z < z1
+struct TerrainRect {
+	int x0;
+	int z0;
+	int x1;
+	int z1;
+
+	TerrainRect();
+	TerrainRect(int x0_, int z0_, int x1_, int z1_);
+
+	bool isEmpty() const {
+		return x0 >= x1 || z0 >= z1;
+	}
+
+	//Grows the rectangle to also cover (x, z)
+	void include(int x, int z);
+	//Grows the rectangle to also cover other
+	void include(const TerrainRect &other);
+	//Returns the rectangle grown by border cells on every side
+	TerrainRect expanded(int border) const;
+	//Returns the part of the rectangle that overlaps other
+	TerrainRect clipped(const TerrainRect &other) const;
+};
+
+//Represents a terrain, by storing a set of heights and normals at 2D locations.
+//The heights and normals each live in one contiguous, cache-line aligned
+//buffer, with rows rowStride() elements apart.  Heights stored as
+//HEIGHTS_UINT16 are rounded to one of 65536 evenly spaced levels between the
+//lowest and highest height given to the constructor.  Normals stored in one
+//of the octahedral formats keep only their direction, and come back with
+//unit length.
+//
+//With LAYOUT_TILED, cells that are near each other in 2D are also near each
+//other in memory, which suits lookups around a point and neighbourhood reads.
+//Such terrains have no row pointers, and are read and written through
+//getHeight/setHeight and the row copies readHeights/writeHeights.
+//
+//A terrain mapped from a file by mapTerrain (see terrainstream.h) is tiled,
+//and pages its tiles in and out of memory as they are used.
+class Terrain {
+	public:
+		//The width and length of the tiles of LAYOUT_TILED, in cells
+		static const int TILE_SIZE = 32;
+		//The number of steps per unit of slope in the gradient field
+		static const int GRADIENT_SCALE = 1024;
+	private:
+		int w; //Width
+		int l; //Length
+		int stride; //Elements between the starts of consecutive rows
+		TerrainLayout layout;
+		int tilesX; //The number of tiles across, for LAYOUT_TILED
+		Arena* arena; //The arena the buffers come from, or NULL to allocate
+		              //them on the heap
+		int* tileBase; //The index of the first cell of each tile, row by row,
+		               //for LAYOUT_TILED
+		size_t cellCount; //The number of elements in each buffer
+		float* hs; //Heights, if they are stored as HEIGHTS_FLOAT
+		unsigned short* qhs; //Heights, if they are stored as HEIGHTS_UINT16
+		float heightScale; //The height between consecutive levels of qhs
+		float heightOffset; //The height of level 0 of qhs
+		bool isHeightRangeKnown; //Whether lowestHeight and highestHeight
+		                         //bound the heights
+		float lowestHeight;
+		float highestHeight;
+		NormalFormat normalFormat;
+		Vec3f* normals; //The normals, if normalFormat is NORMALS_FLOAT
+		unsigned int* octNormals32; //If normalFormat is NORMALS_OCT32
+		unsigned short* octNormals16; //If normalFormat is NORMALS_OCT16
+		TerrainRect dirty; //The cells whose heights changed since the normals
+		                   //were last computed
+		ThreadPool* pool; //The threads to compute normals on, or NULL
+		HeightPyramid* pyramid; //For raycasts, or NULL until the first one
+		TerrainRect pyramidDirty; //The cells whose heights changed since
+		                          //pyramid was last updated
+		TerrainStream* stream; //Pages the tiles of a mapped terrain in and
+		                       //out, or NULL
+		unsigned char* occlusion; //The ambient occlusion of each cell, as
+		                          //0 - 255, or NULL until it is first used
+		TerrainRect occlusionDirty; //The cells whose heights changed since
+		                            //occlusion was last computed
+		unsigned char* shadows; //How lit each cell is by the sun, as
+		                        //0 - 255, or NULL until it is first used
+		Vec3f toLight; //The direction towards the sun
+		bool lightChanged; //Whether toLight changed since shadows were last
+		                   //computed
+		TerrainRect shadowDirty; //The cells whose heights changed since
+		                         //shadows were last computed
+		unsigned int* gradients; //The slope of each cell, with dh/dx in the
+		                         //low 16 bits and dh/dz in the high 16 bits,
+		                         //in steps of 1 / GRADIENT_SCALE, or NULL
+		                         //until it is first used
+		TerrainRect gradientDirty; //The cells whose heights changed since
+		                           //gradients was last computed
+
+		//The kinds of data derived from the heights that a mapped terrain
+		//computes a block of tiles at a time, as the tiles are used
+		enum Derived {
+			DERIVED_NORMALS,
+			DERIVED_OCCLUSION,
+			DERIVED_SHADOWS,
+			DERIVED_GRADIENTS,
+			NUM_DERIVED
+		};
+
+		friend class TerrainStream;
+
+		Terrain() {
+		}
+		Terrain(const Terrain &other);
+		void operator=(const Terrain &other);
+		//Sets up an empty terrain, without allocating any buffers
+		void init(int w2, int l2, NormalFormat normalFormat2,
+				  TerrainLayout layout2, Arena* arena2);
+		void allocateNormals();
+		//Allocates a buffer of size bytes from arena, or from the heap if
+		//there is none
+		void* allocate(size_t size);
+		//Frees a buffer returned by allocate.  Buffers from an arena are
+		//only freed with the arena.
+		void release(void* p);
+		//Returns the index of the tile at (x, z), row by row
+		int tileId(int x, int z) {
+			return (z / TILE_SIZE) * tilesX + x / TILE_SIZE;
+		}
+		//Tells stream that the tile at (x, z) is about to be read, or written
+		void touchStream(int x, int z, bool write);
+		//Makes sure the given kind of derived data of the tile at (x, z) of a
+		//mapped terrain is in memory and up to date
+		void ensureDerived(int x, int z, Derived kind);
+		//Returns the index of the cell at (x, z) in the height and normal
+		//buffers
+		int cellIndex(int x, int z) {
+			if (layout == LAYOUT_ROWS) {
+				return z * stride + x;
+			}
+			unsigned int ux = x;
+			unsigned int uz = z;
+			return tileBase[(uz / TILE_SIZE) * tilesX + ux / TILE_SIZE] +
+				(tileSpread[ux % TILE_SIZE] | (tileSpread[uz % TILE_SIZE] << 1));
+		}
+		//Bit i of each index moved to bit 2 * i, for interleaving the x and z
+		//coordinates within a tile
+		static const unsigned short tileSpread[TILE_SIZE];
+		//Stores the normals of the cells x0 <= x < x1 of row z, encoding them
+		//if needed
+		void storeNormals(int z, int x0, int x1, const Vec3f* in);
+		//Sets the heights of the cells x0 <= x < x1 of row z to those in in,
+		//without invalidating anything
+		void storeHeights(int z, int x0, int x1, const float* in);
+		//Calls f(bandBegin, bandEnd) for bands of rows that together cover
+		//z0 <= z < z1, on the thread pool if there is one.  rowCells is the
+		//number of cells f handles per row, and bands are at least minRows
+		//rows long.
+		template<class F>
+		void forEachBand(int z0, int z1, int rowCells, const F &f,
+						 int minRows = 1);
+		//Recomputes the normals of the cells in rect
+		void computeNormals(const TerrainRect &rect);
+		//Recomputes the ambient occlusion of the cells in rect
+		void computeAmbientOcclusion(const TerrainRect &rect);
+		//Recomputes the shadows of the cells in rect, sweeping each line
+		//through it from as far towards the sun as a shadow can reach
+		void computeShadows(const TerrainRect &rect);
+		//Recomputes the slopes of the cells in rect
+		void computeGradients(const TerrainRect &rect);
+		//Widens the bounds on the heights to take in height
+		void includeHeight(float height) {
+			lowestHeight = height < lowestHeight ? height : lowestHeight;
+			highestHeight = height > highestHeight ? height : highestHeight;
+		}
+		//Marks the data derived from the heights in rect as out of date
+		void markChanged(const TerrainRect &rect) {
+			dirty.include(rect.clipped(bounds()));
+			pyramidDirty.include(rect.clipped(bounds()));
+			occlusionDirty.include(rect.clipped(bounds()));
+			shadowDirty.include(rect.clipped(bounds()));
+			gradientDirty.include(rect.clipped(bounds()));
+		}
+	public:
+		//Makes a terrain that stores heights as HEIGHTS_FLOAT.  If arena2
+		//isn't NULL, the terrain's buffers are allocated from it, and it
+		//must outlive the terrain and only be used on the thread that
+		//creates and updates the terrain.
+		Terrain(int w2, int l2, NormalFormat normalFormat2 = NORMALS_FLOAT,
+				TerrainLayout layout2 = LAYOUT_ROWS, Arena* arena2 = NULL);
+		//Makes a terrain that stores heights as HEIGHTS_UINT16, for heights
+		//from minHeight to maxHeight
+		Terrain(int w2, int l2, float minHeight, float maxHeight,
+				NormalFormat normalFormat2 = NORMALS_FLOAT,
+				TerrainLayout layout2 = LAYOUT_ROWS, Arena* arena2 = NULL);
+		~Terrain();
+
+		int width() {
+			return w;
+		}
+
+		int length() {
+			return l;
+		}
+
+		//Returns the number of elements between the starts of consecutive rows
+		//of heightRow and normalRow
+		int rowStride() {
+			return stride;
+		}
+
+		TerrainLayout getLayout() {
+			return layout;
+		}
+
+		HeightFormat getHeightFormat() {
+			return hs != NULL ? HEIGHTS_FLOAT : HEIGHTS_UINT16;
+		}
+
+		NormalFormat getNormalFormat() {
+			return normalFormat;
+		}
+
+		//Sets the threads that computeNormals splits its work across, or
+		//NULL to compute normals on the calling thread.  The pool must
+		//outlive the terrain or be replaced first.
+		void setThreadPool(ThreadPool* pool2) {
+			pool = pool2;
+		}
+
+		//Returns the whole terrain as a rectangle
+		TerrainRect bounds() {
+			return TerrainRect(0, 0, w, l);
+		}
+
+		//Returns the HEIGHTS_UINT16 level closest to the height y
+		unsigned short quantizeHeight(float y) {
+			float level = (y - heightOffset) / heightScale + 0.5f;
+			if (level <= 0.0f) {
+				return 0;
+			}
+			if (level >= 65535.0f) {
+				return 65535;
+			}
+			return (unsigned short)level;
+		}
+
+		//Returns the height of a HEIGHTS_UINT16 level
+		float dequantizeHeight(unsigned short level) {
+			return level * heightScale + heightOffset;
+		}
+
+		//Sets the height at (x, z) to y
+		void setHeight(int x, int z, float y) {
+			if (stream != NULL) {
+				touchStream(x, z, true);
+			}
+			if (hs != NULL) {
+				hs[cellIndex(x, z)] = y;
+			}
+			else {
+				qhs[cellIndex(x, z)] = quantizeHeight(y);
+			}
+			includeHeight(y);
+			dirty.include(x, z);
+			pyramidDirty.include(x, z);
+			occlusionDirty.include(x, z);
+			shadowDirty.include(x, z);
+			gradientDirty.include(x, z);
+		}
+
+		//Returns the height at (x, z)
+		float getHeight(int x, int z) {
+			if (stream != NULL) {
+				touchStream(x, z, false);
+			}
+			if (hs != NULL) {
+				return hs[cellIndex(x, z)];
+			}
+			return dequantizeHeight(qhs[cellIndex(x, z)]);
+		}
+
+		//Returns the w heights of row z, for terrains that store
+		//HEIGHTS_FLOAT in LAYOUT_ROWS.  Callers that write through the
+		//pointer must call invalidateNormals afterwards.
+		float* heightRow(int z) {
+			assert(hs != NULL && layout == LAYOUT_ROWS);
+			return hs + z * stride;
+		}
+
+		//Returns the w height levels of row z, for terrains that store
+		//HEIGHTS_UINT16 in LAYOUT_ROWS.  Callers that write through the
+		//pointer must call invalidateNormals afterwards.
+		unsigned short* quantizedHeightRow(int z) {
+			assert(qhs != NULL && layout == LAYOUT_ROWS);
+			return qhs + z * stride;
+		}
+
+		//Copies the heights of the cells x0 <= x < x1 of row z to out,
+		//dequantizing them if needed
+		void readHeights(int z, int x0, int x1, float* out);
+
+		//Sets the heights of the cells x0 <= x < x1 of row z to those in in
+		void writeHeights(int z, int x0, int x1, const float* in);
+
+		//Sets every height, calling f(z, row) to fill in the width() heights
+		//of each row z.  Rows are filled in parallel on the thread pool, so f
+		//must be safe to call from several threads at once.
+		void fillHeights(const std::function<void(int, float*)> &f);
+
+		//Returns the w normals of row z, computing the normals if needed.
+		//Only terrains that store NORMALS_FLOAT in LAYOUT_ROWS have normal
+		//rows; others must use readNormals.
+		const Vec3f* normalRow(int z) {
+			assert(normalFormat == NORMALS_FLOAT && layout == LAYOUT_ROWS);
+			if (!dirty.isEmpty()) {
+				computeNormals();
+			}
+			return normals + z * stride;
+		}
+
+		//Copies the normals of the cells x0 <= x < x1 of row z to out,
+		//decoding them if needed
+		void readNormals(int z, int x0, int x1, Vec3f* out);
+
+		//Marks the normals, and the other data derived from the heights, as
+		//out of date after heights were changed through heightRow
+		void invalidateNormals() {
+			dirty = bounds();
+			pyramidDirty = bounds();
+			occlusionDirty = bounds();
+			shadowDirty = bounds();
+			gradientDirty = bounds();
+			isHeightRangeKnown = false;
+		}
+
+		//Marks the normals, and the other data derived from the heights, as
+		//out of date after the heights in rect were changed through heightRow
+		void invalidateNormals(const TerrainRect &rect) {
+			markChanged(rect);
+			isHeightRangeKnown = false;
+		}
+
+		//Sets lowest and highest to bounds on the heights.  The bounds take in
+		//heights as they are set, but don't narrow as heights are lowered.
+		//After heights change through heightRow, the heights are read again.
+		void heightRange(float &lowest, float &highest);
+
+		//Brings the normals up to date, recomputing only those near heights
+		//that changed since they were last computed.  A mapped terrain instead
+		//recomputes the normals of each tile when it is next used.
+		void computeNormals();
+
+		//Returns the normal at (x, z)
+		Vec3f getNormal(int x, int z) {
+			if (!dirty.isEmpty()) {
+				computeNormals();
+			}
+			if (stream != NULL) {
+				ensureDerived(x, z, DERIVED_NORMALS);
+			}
+			switch(normalFormat) {
+				case NORMALS_OCT32:
+					return decodeOct32(octNormals32[cellIndex(x, z)]);
+				case NORMALS_OCT16:
+					return decodeOct16(octNormals16[cellIndex(x, z)]);
+				default:
+					return normals[cellIndex(x, z)];
+			}
+		}
+
+		//Brings the ambient occlusion up to date, recomputing it in parallel
+		//near heights that changed since it was last computed.  It is kept
+		//for every cell once first used.  A mapped terrain instead computes
+		//the occlusion of each block of tiles when it is next used, and keeps
+		//it only while the tiles are in memory.
+		void computeAmbientOcclusion();
+
+		//Returns the fraction of the sky that can be seen from (x, z), past
+		//the terrain around it, from 0 to 1
+		float getAmbientOcclusion(int x, int z) {
+			if (occlusion == NULL || !occlusionDirty.isEmpty()) {
+				computeAmbientOcclusion();
+			}
+			if (stream != NULL) {
+				ensureDerived(x, z, DERIVED_OCCLUSION);
+			}
+			return occlusion[cellIndex(x, z)] / 255.0f;
+		}
+
+		//Copies the ambient occlusion of the cells x0 <= x < x1 of row z to
+		//out
+		void readAmbientOcclusion(int z, int x0, int x1, float* out);
+
+		//Returns the direction towards the sun that casts the terrain's
+		//shadows.  By default, it is straight up.
+		Vec3f lightDirection() {
+			return toLight;
+		}
+
+		//Sets the direction towards the sun.  The shadows are recomputed if
+		//it changed.
+		void setLightDirection(const Vec3f &toLight2);
+
+		//Brings the shadows up to date, by sweeping the terrain away from the
+		//sun along parallel lines.  After edits, only the lines through
+		//heights that changed are swept again.  Lines are swept in parallel.
+		//A mapped terrain instead sweeps the lines through each block of
+		//tiles when it is next used, starting as far towards the sun as the
+		//range of the heights lets a shadow reach.
+		void computeShadows();
+
+		//Returns the cells whose shadows can change when the heights in rect
+		//do: rect, and the cells further from the sun that the shadows of its
+		//heights can reach
+		TerrainRect shadowsCastBy(const TerrainRect &rect);
+
+		//Returns how much of the sun's light reaches (x, z), from 0 in shadow
+		//to 1
+		float getShadow(int x, int z) {
+			if (shadows == NULL || lightChanged || !shadowDirty.isEmpty()) {
+				computeShadows();
+			}
+			if (stream != NULL) {
+				ensureDerived(x, z, DERIVED_SHADOWS);
+			}
+			return shadows[cellIndex(x, z)] / 255.0f;
+		}
+
+		//Copies the shadow factors of the cells x0 <= x < x1 of row z to out
+		void readShadows(int z, int x0, int x1, float* out);
+
+		//Brings the gradient field up to date, recomputing it in parallel
+		//near heights that changed since it was last computed.  Like the
+		//ambient occlusion, it is kept for every cell once first used, and a
+		//mapped terrain instead computes it a block of tiles at a time.
+		void computeGradients();
+
+		//Sets dhdx and dhdz to the slope of the terrain at (x, z),
+		//interpolated bilinearly between the slopes of the four cells around
+		//it.  Points off the terrain get the slope at its edge.
+		void getGradient(float x, float z, float &dhdx, float &dhdz) {
+			if (gradients == NULL || !gradientDirty.isEmpty()) {
+				computeGradients();
+			}
+			x = x < 0.0f ? 0.0f : (x > w - 1 ? w - 1 : x);
+			z = z < 0.0f ? 0.0f : (z > l - 1 ? l - 1 : z);
+			int x0 = (int)x;
+			int z0 = (int)z;
+			int x1 = x0 + 1 < w ? x0 + 1 : x0;
+			int z1 = z0 + 1 < l ? z0 + 1 : z0;
+			if (stream != NULL) {
+				ensureDerived(x0, z0, DERIVED_GRADIENTS);
+				ensureDerived(x1, z0, DERIVED_GRADIENTS);
+				ensureDerived(x0, z1, DERIVED_GRADIENTS);
+				ensureDerived(x1, z1, DERIVED_GRADIENTS);
+			}
+			float fx = x - x0;
+			float fz = z - z0;
+			unsigned int g00 = gradients[cellIndex(x0, z0)];
+			unsigned int g10 = gradients[cellIndex(x1, z0)];
+			unsigned int g01 = gradients[cellIndex(x0, z1)];
+			unsigned int g11 = gradients[cellIndex(x1, z1)];
+			float w00 = (1.0f - fx) * (1.0f - fz);
+			float w10 = fx * (1.0f - fz);
+			float w01 = (1.0f - fx) * fz;
+			float w11 = fx * fz;
+			dhdx = (w00 * (short)(g00 & 0xffff) + w10 * (short)(g10 & 0xffff) +
+					w01 * (short)(g01 & 0xffff) + w11 * (short)(g11 & 0xffff)) /
+				GRADIENT_SCALE;
+			dhdz = (w00 * (short)(g00 >> 16) + w10 * (short)(g10 >> 16) +
+					w01 * (short)(g01 >> 16) + w11 * (short)(g11 >> 16)) /
+				GRADIENT_SCALE;
+		}
+
+		//Returns what pages the tiles of a mapped terrain in and out of
+		//memory, or NULL if the terrain isn't mapped
+		TerrainStream* getStream() {
+			return stream;
+		}
+
+		//Asks a mapped terrain to read the tiles near the segment from (x, z)
+		//to (x + dx, z + dz) from disk in the background, so that they're in
+		//memory by the time they're used.  Does nothing for a terrain that
+		//isn't mapped.
+		void prefetch(float x, float z, float dx, float dz);
+
+		//Finds the first point where the ray origin + t * dir, for
+		//0 <= t <= maxT, meets the drawn surface of the terrain.  Returns
+		//whether there is one, and if so sets t.  The first call builds a
+		//min/max height pyramid, which later calls update incrementally.
+		bool raycast(const Vec3f &origin, const Vec3f &dir, float maxT,
+					 float &t);
+};
+
+//Loads a terrain from a bitmap heightmap, which may be 4 or 8-bit grayscale
+//or paletted, 16-bit grayscale, or 24-bit, whose red components are used.
+//The heights of the terrain range from -height / 2 to height / 2.  If pool
+//isn't NULL, the pixels are converted to heights on its threads, and the
+//terrain uses it to compute normals.  If arena isn't NULL, the terrain's
+//buffers are allocated from it.
+Terrain* loadTerrain(const char* filename, float height,
+					 ThreadPool* pool = NULL,
+					 NormalFormat normalFormat = NORMALS_FLOAT,
+					 HeightFormat heightFormat = HEIGHTS_FLOAT,
+					 TerrainLayout layout = LAYOUT_ROWS, Arena* arena = NULL);
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,114 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <math.h>
+
+#include <vector>
+
+#include "terrainedit.h"
+
+using namespace std;
+
+namespace {
+	//The height of a crater's rim, relative to its depth
+	const float RIM_HEIGHT = 0.25f;
+	//How far out a crater's rim reaches, relative to its radius
+	const float RIM_EXTENT = 1.5f;
+
+	//Returns the cells within radius of (x, z), clipped to t
+	TerrainRect cellsNear(Terrain* t, float x, float z, float radius) {
+		return TerrainRect((int)ceilf(x - radius), (int)ceilf(z - radius),
+						   (int)floorf(x + radius) + 1,
+						   (int)floorf(z + radius) + 1).clipped(t->bounds());
+	}
+
+	//Sets the height of each cell in rect to f(x, z, height), a row at a
+	//time, and returns rect
+	template<class F>
+	TerrainRect deform(Terrain* t, const TerrainRect &rect, const F &f) {
+		if (rect.isEmpty()) {
+			return rect;
+		}
+		vector<float> row(rect.x1 - rect.x0);
+		for(int z = rect.z0; z < rect.z1; z++) {
+			t->readHeights(z, rect.x0, rect.x1, &row[0]);
+			for(int x = rect.x0; x < rect.x1; x++) {
+				row[x - rect.x0] = f(x, z, row[x - rect.x0]);
+			}
+			t->writeHeights(z, rect.x0, rect.x1, &row[0]);
+		}
+		return rect;
+	}
+}
+
+TerrainRect digCrater(Terrain* t, float x, float z, float radius,
+					  float depth) {
+	float rim = RIM_HEIGHT * depth;
+	return deform(t, cellsNear(t, x, z, RIM_EXTENT * radius),
+				  [=](int cx, int cz, float height) {
+		float d = sqrtf((cx - x) * (cx - x) + (cz - z) * (cz - z)) / radius;
+		if (d < 1.0f) {
+			//A parabolic bowl, rising from -depth at the centre to the top
+			//of the rim at its edge
+			return height + (d * d - 1.0f) * depth + d * d * rim;
+		}
+		else if (d < RIM_EXTENT) {
+			float s = (RIM_EXTENT - d) / (RIM_EXTENT - 1.0f);
+			return height + s * s * rim;
+		}
+		return height;
+	});
+}
+
+TerrainRect applyBrush(Terrain* t, float x, float z, float radius,
+					   float amount) {
+	return deform(t, cellsNear(t, x, z, radius),
+				  [=](int cx, int cz, float height) {
+		float d2 = ((cx - x) * (cx - x) + (cz - z) * (cz - z)) /
+			(radius * radius);
+		if (d2 >= 1.0f) {
+			return height;
+		}
+		float s = 1.0f - d2;
+		return height + amount * s * s;
+	});
+}
+
+TerrainRect stampHeights(Terrain* t, int x0, int z0, int w, int l,
+						 const float* stamp, float amount) {
+	TerrainRect rect = TerrainRect(x0, z0, x0 + w, z0 + l).clipped(t->bounds());
+	return deform(t, rect, [=](int x, int z, float height) {
+		return height + amount * stamp[(z - z0) * w + (x - x0)];
+	});
+}
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,58 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef TERRAIN_EDIT_H_INCLUDED
+#define TERRAIN_EDIT_H_INCLUDED
+
+#include "terrain.h"
+
+/* Edits that change a patch of a terrain at once.  Each returns the cells
+ * whose heights it changed, clipped to the terrain, and only the normals near
+ * those cells are recomputed, the next time they're read.
+ */
+
+//Digs a bowl-shaped crater of the given radius and depth centred at (x, z),
+//with a raised rim around it
+TerrainRect digCrater(Terrain* t, float x, float z, float radius, float depth);
+
+//Raises the terrain around (x, z) by amount, or lowers it if amount is
+//negative, falling off smoothly to nothing at the given radius
+TerrainRect applyBrush(Terrain* t, float x, float z, float radius,
+					   float amount);
+
+//Adds amount times the heights of a w x l stamp, given row by row, to the
+//terrain, with the stamp's corner at (x0, z0)
+TerrainRect stampHeights(Terrain* t, int x0, int z0, int w, int l,
+						 const float* stamp, float amount);
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,165 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "terraingen.h"
+
+using namespace std;
+
+namespace {
+	//The weight of each octave relative to the one before it
+	const float GAIN = 0.5f;
+	//Scales gradient noise, whose values lie within +-sqrt(1 / 2), to +-1
+	const float NOISE_SCALE = 1.41421356f;
+
+	//Mixes the lattice point (x, z) and a seed into 32 well-scrambled bits
+	unsigned int hashPoint(int x, int z, unsigned int seed) {
+		unsigned int h = seed ^ ((unsigned int)x * 0x8da6b343u) ^
+			((unsigned int)z * 0xd8163841u);
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return h;
+	}
+
+	//The eight unit gradients of the noise, as (x, z) pairs
+	const float GRADIENTS[8][2] = {
+		{1.0f, 0.0f}, {-1.0f, 0.0f}, {0.0f, 1.0f}, {0.0f, -1.0f},
+		{0.70710678f, 0.70710678f}, {0.70710678f, -0.70710678f},
+		{-0.70710678f, 0.70710678f}, {-0.70710678f, -0.70710678f}
+	};
+
+	float fade(float t) {
+		return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+	}
+
+	float lerp(float a, float b, float t) {
+		return a + (b - a) * t;
+	}
+
+	//Adds amplitude times Perlin's gradient noise at (x * frequency + dx0, z)
+	//to row[x] for 0 <= x < w
+	void addNoiseRow(float* row, int w, float frequency, float dx0, float z,
+					 unsigned int seed, float amplitude) {
+		float fz = floorf(z);
+		int iz = (int)fz;
+		float dz = z - fz;
+		float v = fade(dz);
+		int ix = 0;
+		const float* g00 = NULL;
+		const float* g10 = NULL;
+		const float* g01 = NULL;
+		const float* g11 = NULL;
+		for(int x = 0; x < w; x++) {
+			float px = x * frequency + dx0;
+			float fx = floorf(px);
+			//Neighbouring cells usually share a lattice square, so only hash
+			//its corners when moving into a new one
+			if (g00 == NULL || (int)fx != ix) {
+				ix = (int)fx;
+				g00 = GRADIENTS[hashPoint(ix, iz, seed) & 7];
+				g10 = GRADIENTS[hashPoint(ix + 1, iz, seed) & 7];
+				g01 = GRADIENTS[hashPoint(ix, iz + 1, seed) & 7];
+				g11 = GRADIENTS[hashPoint(ix + 1, iz + 1, seed) & 7];
+			}
+			float dx = px - fx;
+			float n00 = g00[0] * dx + g00[1] * dz;
+			float n10 = g10[0] * (dx - 1.0f) + g10[1] * dz;
+			float n01 = g01[0] * dx + g01[1] * (dz - 1.0f);
+			float n11 = g11[0] * (dx - 1.0f) + g11[1] * (dz - 1.0f);
+			float u = fade(dx);
+			row[x] += amplitude * lerp(lerp(n00, n10, u), lerp(n01, n11, u), v);
+		}
+	}
+}
+
+void generateHeights(Terrain* t, float height, unsigned int seed) {
+	//Halve the wavelength every octave, from half the size of the terrain
+	//down to two cells
+	float baseWavelength = max(t->width(), t->length()) / 2.0f;
+	int numOctaves = 1;
+	while (baseWavelength / (1 << numOctaves) >= 2.0f && numOctaves < 24) {
+		numOctaves++;
+	}
+
+	//Shift each octave by a random offset, so that the lattices of the
+	//octaves don't all line up at the origin
+	vector<float> offsetX(numOctaves);
+	vector<float> offsetZ(numOctaves);
+	vector<unsigned int> seeds(numOctaves);
+	float totalAmplitude = 0.0f;
+	for(int i = 0; i < numOctaves; i++) {
+		seeds[i] = hashPoint(i, -1, seed);
+		offsetX[i] = (hashPoint(i, -2, seed) >> 8) / 16777216.0f * 256.0f;
+		offsetZ[i] = (hashPoint(i, -3, seed) >> 8) / 16777216.0f * 256.0f;
+		totalAmplitude += powf(GAIN, (float)i);
+	}
+	float scale = height / 2 * NOISE_SCALE / totalAmplitude;
+
+	int w = t->width();
+	t->fillHeights([&](int z, float* row) {
+		fill(row, row + w, 0.0f);
+		float frequency = 1.0f / baseWavelength;
+		float amplitude = scale;
+		for(int i = 0; i < numOctaves; i++) {
+			addNoiseRow(row, w, frequency, offsetX[i],
+						z * frequency + offsetZ[i], seeds[i], amplitude);
+			frequency *= 2.0f;
+			amplitude *= GAIN;
+		}
+	});
+}
+
+Terrain* generateTerrain(int w, int l, float height, unsigned int seed,
+						 ThreadPool* pool, NormalFormat normalFormat,
+						 HeightFormat heightFormat, TerrainLayout layout,
+						 Arena* arena) {
+	Terrain* t;
+	if (heightFormat == HEIGHTS_UINT16) {
+		t = new Terrain(w, l, -height / 2, height / 2, normalFormat, layout,
+						arena);
+	}
+	else {
+		t = new Terrain(w, l, normalFormat, layout, arena);
+	}
+	t->setThreadPool(pool);
+	generateHeights(t, height, seed);
+	t->computeNormals();
+	return t;
+}
+
+
+
+
+
+
+
+
+
+
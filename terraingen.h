@@ -0,0 +1,57 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef TERRAIN_GEN_H_INCLUDED
+#define TERRAIN_GEN_H_INCLUDED
+
+#include "terrain.h"
+
+class ThreadPool;
+
+//Sets the heights of t to fractal noise (fractional Brownian motion over
+//gradient noise) between -height / 2 and height / 2.  The largest hills are
+//about half as wide as the terrain, and the smallest a couple of cells.  The
+//same seed always gives the same heights, however many threads fill them.
+void generateHeights(Terrain* t, float height, unsigned int seed);
+
+//Makes a w x l terrain with heights from generateHeights, and computes its
+//normals, using pool if it isn't NULL.  If arena isn't NULL, the terrain's
+//buffers are allocated from it.
+Terrain* generateTerrain(int w, int l, float height, unsigned int seed,
+						 ThreadPool* pool = NULL,
+						 NormalFormat normalFormat = NORMALS_FLOAT,
+						 HeightFormat heightFormat = HEIGHTS_FLOAT,
+						 TerrainLayout layout = LAYOUT_ROWS,
+						 Arena* arena = NULL);
+
+
+
+
+
+
+
+
+
+
+#endif
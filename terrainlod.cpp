@@ -0,0 +1,356 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "horizonbake.h"
+#include "terrain.h"
+#include "terrainlod.h"
+#include "terrainstream.h"
+
+using namespace std;
+
+namespace {
+	//Sets out to the coordinates a0, a0 + step, ... below a1, followed by a1
+	void axisCoords(int a0, int a1, int step, vector<int> &out) {
+		out.clear();
+		for(int a = a0; a < a1; a += step) {
+			out.push_back(a);
+		}
+		out.push_back(a1);
+	}
+
+	//Returns the normal at (x, z) from the slope between the heights step
+	//cells to either side, for chunks that don't read the terrain's normals
+	Vec3f coarseNormal(Terrain* terrain, int x, int z, int step) {
+		int xLo = max(x - step, 0);
+		int xHi = min(x + step, terrain->width() - 1);
+		int zLo = max(z - step, 0);
+		int zHi = min(z + step, terrain->length() - 1);
+		float dhdx = (terrain->getHeight(xHi, z) - terrain->getHeight(xLo, z)) /
+			(xHi - xLo);
+		float dhdz = (terrain->getHeight(x, zHi) - terrain->getHeight(x, zLo)) /
+			(zHi - zLo);
+		return Vec3f(-dhdx, 1.0f, -dhdz).normalize();
+	}
+}
+
+TerrainLod::TerrainLod(Terrain* terrain2) : terrain(terrain2), vertexBytes(0) {
+	chunksX = max((terrain->width() - 2) / CHUNK_SIZE + 1, 1);
+	chunksZ = max((terrain->length() - 2) / CHUNK_SIZE + 1, 1);
+	lodDistance = 256.0f;
+	levels.resize(chunksX * chunksZ, 0);
+	distances.resize(chunksX * chunksZ);
+	chunks.resize(chunksX * chunksZ);
+	for(size_t i = 0; i < chunks.size(); i++) {
+		chunks[i].level = -1;
+		chunks[i].isEdited = true;
+	}
+	heightRow.resize(CHUNK_SIZE + 1);
+	normalRow.resize(CHUNK_SIZE + 1);
+	occlusionRow.resize(CHUNK_SIZE + 1);
+	shadowRow.resize(CHUNK_SIZE + 1);
+}
+
+TerrainLod::~TerrainLod() {
+	if (terrain->getStream() != NULL) {
+		terrain->getStream()->reserve(0);
+	}
+}
+
+int TerrainLod::chunkLevel(int cx, int cz) {
+	if (cx < 0 || cx >= chunksX || cz < 0 || cz >= chunksZ) {
+		return -1;
+	}
+	return levels[cz * chunksX + cx];
+}
+
+size_t TerrainLod::pickLevels(float distance0) {
+	size_t bytes = 0;
+	for(int cz = 0; cz < chunksZ; cz++) {
+		int z0 = cz * CHUNK_SIZE;
+		int z1 = min(z0 + CHUNK_SIZE, terrain->length() - 1);
+		for(int cx = 0; cx < chunksX; cx++) {
+			int x0 = cx * CHUNK_SIZE;
+			int x1 = min(x0 + CHUNK_SIZE, terrain->width() - 1);
+			int level = 0;
+			while (level < NUM_LEVELS - 1 &&
+				   distances[cz * chunksX + cx] >= distance0 * (1 << level)) {
+				level++;
+			}
+			levels[cz * chunksX + cx] = level;
+
+			//The grid has a vertex every step cells and one at the far edge,
+			//and the strips twice as many for each row but the last
+			int step = 1 << level;
+			size_t gridX = (x1 - x0 - 1) / step + 2;
+			size_t gridZ = (z1 - z0 - 1) / step + 2;
+			bytes += (gridX * gridZ + 2 * gridX * (gridZ - 1)) *
+				sizeof(LodVertex);
+		}
+	}
+	return bytes;
+}
+
+void TerrainLod::update(const Vec3f &eye) {
+	//Measure each chunk's distance from the camera to the nearest point of
+	//the chunk at the height of its middle
+	for(int cz = 0; cz < chunksZ; cz++) {
+		int z0 = cz * CHUNK_SIZE;
+		int z1 = min(z0 + CHUNK_SIZE, terrain->length() - 1);
+		for(int cx = 0; cx < chunksX; cx++) {
+			int x0 = cx * CHUNK_SIZE;
+			int x1 = min(x0 + CHUNK_SIZE, terrain->width() - 1);
+			Chunk &chunk = chunks[cz * chunksX + cx];
+			if (chunk.isEdited) {
+				chunk.middleHeight =
+					terrain->getHeight((x0 + x1) / 2, (z0 + z1) / 2);
+				chunk.isEdited = false;
+			}
+			float dx = max(max(x0 - eye[0], eye[0] - x1), 0.0f);
+			float dz = max(max(z0 - eye[2], eye[2] - z1), 0.0f);
+			float dy = eye[1] - chunk.middleHeight;
+			distances[cz * chunksX + cx] = sqrtf(dx * dx + dy * dy + dz * dz);
+		}
+	}
+
+	//Pick each chunk's level by its distance, coarsening them all while the
+	//vertices would take more than half of a mapped terrain's budget
+	TerrainStream* stream = terrain->getStream();
+	float distance0 = lodDistance;
+	size_t bytes = pickLevels(distance0);
+	while (stream != NULL && bytes > stream->budget() / 2 &&
+		   distance0 >= 1.0f) {
+		distance0 *= 0.8f;
+		bytes = pickLevels(distance0);
+	}
+
+	stripVertices.clear();
+	stripCounts.clear();
+	if (terrain->width() < 2 || terrain->length() < 2) {
+		return;
+	}
+
+	//Sample the coarsest chunks first, so that on a mapped terrain the tiles
+	//under the finest ones are the last used, and the last to be dropped
+	for(int level = NUM_LEVELS - 1; level >= 0; level--) {
+		for(int i = 0; i < chunksX * chunksZ; i++) {
+			if (levels[i] == level && chunks[i].level != level) {
+				sampleChunk(i % chunksX, i / chunksX);
+			}
+		}
+	}
+	if (stream != NULL) {
+		stream->reserve(vertexBytes);
+	}
+
+	for(int cz = 0; cz < chunksZ; cz++) {
+		for(int cx = 0; cx < chunksX; cx++) {
+			Chunk &chunk = chunks[cz * chunksX + cx];
+			int neighbourLevels[4] = {
+				chunkLevel(cx, cz - 1),
+				chunkLevel(cx, cz + 1),
+				chunkLevel(cx - 1, cz),
+				chunkLevel(cx + 1, cz)
+			};
+			if (!equal(neighbourLevels, neighbourLevels + 4,
+					   chunk.neighbourLevels)) {
+				copy(neighbourLevels, neighbourLevels + 4,
+					 chunk.neighbourLevels);
+				stitchChunk(cx, cz);
+			}
+
+			int count = 2 * chunk.nx;
+			for(size_t i = 0; i < chunk.strips.size(); i += count) {
+				stripVertices.push_back(&chunk.strips[i]);
+				stripCounts.push_back(count);
+			}
+		}
+	}
+}
+
+void TerrainLod::invalidate(const TerrainRect &rect) {
+	//A height feeds the normals of the cells next to it, the occlusion of
+	//those up to OCCLUSION_RADIUS away and the shadows of those further
+	//from the sun
+	TerrainRect affected =
+		rect.expanded(OCCLUSION_RADIUS).clipped(terrain->bounds());
+	affected.include(terrain->shadowsCastBy(rect));
+	if (affected.isEmpty()) {
+		return;
+	}
+
+	//Chunks share the cells along their edges
+	int cx0 = max(affected.x0 - 1, 0) / CHUNK_SIZE;
+	int cx1 = min((affected.x1 - 1) / CHUNK_SIZE, chunksX - 1);
+	int cz0 = max(affected.z0 - 1, 0) / CHUNK_SIZE;
+	int cz1 = min((affected.z1 - 1) / CHUNK_SIZE, chunksZ - 1);
+	for(int cz = cz0; cz <= cz1; cz++) {
+		for(int cx = cx0; cx <= cx1; cx++) {
+			Chunk &chunk = chunks[cz * chunksX + cx];
+			chunk.level = -1;
+			chunk.isEdited = true;
+		}
+	}
+}
+
+void TerrainLod::sampleChunk(int cx, int cz) {
+	int x0 = cx * CHUNK_SIZE;
+	int x1 = min(x0 + CHUNK_SIZE, terrain->width() - 1);
+	int z0 = cz * CHUNK_SIZE;
+	int z1 = min(z0 + CHUNK_SIZE, terrain->length() - 1);
+	Chunk &chunk = chunks[cz * chunksX + cx];
+	chunk.level = levels[cz * chunksX + cx];
+	axisCoords(x0, x1, 1 << chunk.level, xs);
+	axisCoords(z0, z1, 1 << chunk.level, zs);
+	int nx = (int)xs.size();
+	int nz = (int)zs.size();
+
+	//Swap in fresh buffers, so that a chunk that drops to a coarser level
+	//also drops the memory of the finer one
+	chunk.nx = nx;
+	if (chunk.grid.size() != (size_t)(nx * nz)) {
+		vertexBytes -= (chunk.grid.size() + chunk.strips.size()) *
+			sizeof(LodVertex);
+		vector<LodVertex>(nx * nz).swap(chunk.grid);
+		vector<LodVertex>(2 * nx * (nz - 1)).swap(chunk.strips);
+		vertexBytes += (chunk.grid.size() + chunk.strips.size()) *
+			sizeof(LodVertex);
+	}
+
+	bool isCoarse = terrain->getStream() != NULL &&
+		chunk.level >= DERIVED_LEVELS;
+	for(int k = 0; k < nz; k++) {
+		terrain->readHeights(zs[k], x0, x1 + 1, &heightRow[0]);
+		if (isCoarse) {
+			for(int j = 0; j < nx; j++) {
+				LodVertex &v = chunk.grid[k * nx + j];
+				v.position = Vec3f((float)xs[j], heightRow[xs[j] - x0],
+								   (float)zs[k]);
+				v.normal = coarseNormal(terrain, xs[j], zs[k],
+										1 << chunk.level);
+				v.occlusion = 1.0f;
+				v.shadow = 1.0f;
+			}
+			continue;
+		}
+
+		terrain->readNormals(zs[k], x0, x1 + 1, &normalRow[0]);
+		terrain->readAmbientOcclusion(zs[k], x0, x1 + 1, &occlusionRow[0]);
+		terrain->readShadows(zs[k], x0, x1 + 1, &shadowRow[0]);
+		for(int j = 0; j < nx; j++) {
+			LodVertex &v = chunk.grid[k * nx + j];
+			v.position = Vec3f((float)xs[j], heightRow[xs[j] - x0],
+							   (float)zs[k]);
+			v.normal = normalRow[xs[j] - x0];
+			v.occlusion = occlusionRow[xs[j] - x0];
+			v.shadow = shadowRow[xs[j] - x0];
+		}
+	}
+
+	//The strips have to be stitched again
+	fill(chunk.neighbourLevels, chunk.neighbourLevels + 4, -2);
+}
+
+void TerrainLod::stitchChunk(int cx, int cz) {
+	Chunk &chunk = chunks[cz * chunksX + cx];
+	int x0 = cx * CHUNK_SIZE;
+	int x1 = min(x0 + CHUNK_SIZE, terrain->width() - 1);
+	int z0 = cz * CHUNK_SIZE;
+	int z1 = min(z0 + CHUNK_SIZE, terrain->length() - 1);
+	axisCoords(x0, x1, 1 << chunk.level, xs);
+	axisCoords(z0, z1, 1 << chunk.level, zs);
+	int nx = chunk.nx;
+	int nz = (int)chunk.grid.size() / nx;
+
+	stitched = chunk.grid;
+	stitchEdge(&stitched[0], 1, xs, chunk.neighbourLevels[0]);
+	stitchEdge(&stitched[(nz - 1) * nx], 1, xs, chunk.neighbourLevels[1]);
+	stitchEdge(&stitched[0], nx, zs, chunk.neighbourLevels[2]);
+	stitchEdge(&stitched[nx - 1], nx, zs, chunk.neighbourLevels[3]);
+
+	for(int k = 0; k + 1 < nz; k++) {
+		LodVertex* strip = &chunk.strips[2 * k * nx];
+		for(int j = 0; j < nx; j++) {
+			strip[2 * j] = stitched[k * nx + j];
+			strip[2 * j + 1] = stitched[(k + 1) * nx + j];
+		}
+	}
+}
+
+void TerrainLod::stitchEdge(LodVertex* first, int spacing,
+							const vector<int> &as, int neighbourLevel) {
+	int n = (int)as.size();
+	if (neighbourLevel < 0 || n <= 2) {
+		return;
+	}
+
+	//The neighbour's edge runs straight between its vertices at multiples
+	//of its step and at the end of the edge, and those are vertices here too
+	int step = as[1] - as[0];
+	int neighbourStep = 1 << neighbourLevel;
+	if (neighbourStep <= step) {
+		return;
+	}
+	for(int j = 1; j < n - 1; j++) {
+		int a = as[j];
+		int lo = a - a % neighbourStep;
+		if (lo == a) {
+			continue;
+		}
+		int hi = min(lo + neighbourStep, as[n - 1]);
+		int jLo = (lo - as[0]) / step;
+		int jHi = hi == as[n - 1] ? n - 1 : (hi - as[0]) / step;
+		const LodVertex &vLo = first[jLo * spacing];
+		const LodVertex &vHi = first[jHi * spacing];
+		float t = (float)(a - lo) / (hi - lo);
+
+		LodVertex &v = first[j * spacing];
+		v.position[1] = vLo.position[1] +
+			(vHi.position[1] - vLo.position[1]) * t;
+		v.normal = (vLo.normal * (1.0f - t) + vHi.normal * t).normalize();
+		v.occlusion = vLo.occlusion + (vHi.occlusion - vLo.occlusion) * t;
+		v.shadow = vLo.shadow + (vHi.shadow - vLo.shadow) * t;
+	}
+}
+
+int TerrainLod::numTriangles() {
+	int count = 0;
+	for(size_t i = 0; i < stripCounts.size(); i++) {
+		count += stripCounts[i] - 2;
+	}
+	return count;
+}
+
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,186 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef TERRAIN_LOD_H_INCLUDED
+#define TERRAIN_LOD_H_INCLUDED
+
+#include <vector>
+
+#include "vec3f.h"
+
+class Terrain;
+struct TerrainRect;
+
+//A vertex of the terrain's surface, in the terrain's coordinates
+struct LodVertex {
+	Vec3f position;
+	Vec3f normal;
+	float occlusion; //See Terrain::getAmbientOcclusion
+	float shadow; //See Terrain::getShadow
+};
+
+/* Geometric mipmapping of a terrain.  The terrain is split into chunks of
+ * CHUNK_SIZE x CHUNK_SIZE cells, and each chunk is drawn at one of NUM_LEVELS
+ * levels of detail, where level k uses every 2^k-th height in each direction.
+ * Chunks further from the camera get coarser levels, so the number of
+ * triangles follows how much of the screen the terrain covers rather than its
+ * size.
+ *
+ * Where a chunk meets a coarser neighbour, the vertices along the shared edge
+ * that the neighbour doesn't have are moved onto the neighbour's edge, so that
+ * no cracks open between them.
+ *
+ * Each chunk keeps the vertices of its level between updates.  It is only
+ * sampled from the terrain again when its level changes or an edit near it is
+ * passed to invalidate, and its edges are only stitched again when the level
+ * of a neighbour changes, so a still camera costs little more than handing
+ * out the strips.
+ *
+ * On a mapped terrain (see terrainstream.h), only chunks finer than
+ * DERIVED_LEVELS read the normals, ambient occlusion and shadows.  Coarser
+ * chunks read just the heights, take their normals from the slope between
+ * them, and are drawn unoccluded and lit, so that distant chunks don't make
+ * the terrain compute data for tiles it would soon drop again.  The memory of
+ * the vertices is set aside from the stream's budget, and if the levels for
+ * the LOD distance would need more than half of it, the chunks are given the
+ * levels of a shorter distance that fits.
+ */
+class TerrainLod {
+	private:
+		Terrain* terrain;
+		int chunksX;
+		int chunksZ;
+		float lodDistance;
+		std::vector<int> levels; //The level of each chunk, row by row
+		std::vector<float> distances; //The distance of each chunk from the
+		                              //camera, row by row
+
+		//What is kept of each chunk between updates
+		struct Chunk {
+			int level; //The level grid was sampled at, or -1 if it has to be
+			           //sampled again
+			bool isEdited; //Whether the heights changed near the chunk since
+			               //middleHeight was read
+			float middleHeight; //The height at the middle of the chunk
+			std::vector<LodVertex> grid; //The vertices of the level, row by
+			                             //row, before stitching
+			int nx; //The number of vertices in each row of grid
+			int neighbourLevels[4]; //The levels the edges of strips were
+			                        //stitched to, above, below, left and
+			                        //right
+			std::vector<LodVertex> strips; //The stitched triangle strips
+		};
+		std::vector<Chunk> chunks; //Row by row
+		size_t vertexBytes; //The bytes of the grids and strips of all chunks
+
+		//The first vertex of each strip, and the number of vertices in each
+		std::vector<const LodVertex*> stripVertices;
+		std::vector<int> stripCounts;
+
+		//Scratch space for building a chunk
+		std::vector<int> xs;
+		std::vector<int> zs;
+		std::vector<LodVertex> stitched;
+		std::vector<float> heightRow;
+		std::vector<Vec3f> normalRow;
+		std::vector<float> occlusionRow;
+		std::vector<float> shadowRow;
+
+		TerrainLod(const TerrainLod &other);
+		void operator=(const TerrainLod &other);
+
+		//Returns the level of the chunk (cx, cz), or -1 past the edges
+		int chunkLevel(int cx, int cz);
+		//Sets levels from distances for chunks that drop to half resolution
+		//at distance0, and returns the bytes of vertices they need
+		size_t pickLevels(float distance0);
+		//Moves the vertices of the grid along one edge of a chunk onto the
+		//edge of a neighbour with the given level
+		void stitchEdge(LodVertex* first, int spacing,
+						const std::vector<int> &as, int neighbourLevel);
+		//Samples the grid of the chunk (cx, cz) at its level
+		void sampleChunk(int cx, int cz);
+		//Stitches the grid of the chunk (cx, cz) to its neighbours, and lays
+		//it out as strips
+		void stitchChunk(int cx, int cz);
+	public:
+		static const int CHUNK_SIZE = 32;
+		static const int NUM_LEVELS = 6;
+		//The levels that read the derived data of a mapped terrain
+		static const int DERIVED_LEVELS = 2;
+
+		explicit TerrainLod(Terrain* terrain2);
+		~TerrainLod();
+
+		//Returns the distance from the camera, in cells, at which chunks drop
+		//to half resolution.  Each doubling of the distance halves it again.
+		float getLodDistance() {
+			return lodDistance;
+		}
+
+		void setLodDistance(float lodDistance2) {
+			lodDistance = lodDistance2;
+		}
+
+		//Picks the level of each chunk for a camera at eye, given in the
+		//terrain's coordinates, and builds the triangle strips to draw
+		void update(const Vec3f &eye);
+
+		//Notes that the heights in rect changed, such as the rect returned
+		//by digCrater, so that the chunks whose vertices they affect are
+		//sampled again by the next update.  After the light moves, pass the
+		//terrain's bounds.
+		void invalidate(const TerrainRect &rect);
+
+		//Returns the level of detail picked for the chunk (cx, cz)
+		int level(int cx, int cz) {
+			return levels[cz * chunksX + cx];
+		}
+
+		//Returns the number of triangle strips built by update
+		int numStrips() {
+			return (int)stripCounts.size();
+		}
+
+		//Returns the vertices of triangle strip i, and sets count to their
+		//number
+		const LodVertex* strip(int i, int &count) {
+			count = stripCounts[i];
+			return stripVertices[i];
+		}
+
+		//Returns the number of triangles in the strips built by update
+		int numTriangles();
+};
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,459 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <assert.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include "terrainstream.h"
+
+using namespace std;
+
+namespace {
+	const int FILE_VERSION = 2;
+
+	//The start of a terrain file
+	struct FileHeader {
+		char magic[4]; //"TERH"
+		int version;
+		int width;
+		int length;
+		int tileSize;
+		int heightFormat;
+		float heightScale;
+		float heightOffset;
+		float lowestHeight; //The range of the heights
+		float highestHeight;
+	};
+
+	const int TILE_CELLS = Terrain::TILE_SIZE * Terrain::TILE_SIZE;
+
+	//Returns the greatest common divisor of a and b
+	size_t gcd(size_t a, size_t b) {
+		while (b != 0) {
+			size_t r = a % b;
+			a = b;
+			b = r;
+		}
+		return a;
+	}
+
+	//Returns the fewest consecutive tiles whose tileBytes each add up to a
+	//whole number of pages
+	int tilesFillingPages(size_t tileBytes, size_t pageSize) {
+		return (int)(pageSize / gcd(pageSize, tileBytes));
+	}
+
+	size_t normalSize(NormalFormat normalFormat) {
+		switch(normalFormat) {
+			case NORMALS_FLOAT:
+				return sizeof(Vec3f);
+			case NORMALS_OCT32:
+				return sizeof(unsigned int);
+			default:
+				return sizeof(unsigned short);
+		}
+	}
+}
+
+TerrainStream::TerrainStream(Terrain* terrain2, int fd2, char* file2,
+							 size_t fileBytes2, size_t residentBytes) :
+	terrain(terrain2), fd(fd2), file(file2), fileBytes(fileBytes2),
+	budgetBytes(residentBytes), rankTiles(terrain2->cellCount / TILE_CELLS),
+	lastBlock(-1),
+	stopping(false) {
+	pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+	size_t heightSize = terrain->hs != NULL ? sizeof(float)
+		: sizeof(unsigned short);
+	size_t derivedSize[Terrain::NUM_DERIVED];
+	derivedSize[Terrain::DERIVED_NORMALS] = normalSize(terrain->normalFormat);
+	derivedSize[Terrain::DERIVED_OCCLUSION] = sizeof(unsigned char);
+	derivedSize[Terrain::DERIVED_SHADOWS] = sizeof(unsigned char);
+	derivedSize[Terrain::DERIVED_GRADIENTS] = sizeof(unsigned int);
+
+	//The heights and each kind of derived data of a block must be whole
+	//pages, or dropping the block couldn't give their memory back.  The
+	//counts are powers of two, so the largest is a multiple of the others.
+	tilesPerBlock = tilesFillingPages(heightSize * TILE_CELLS, pageSize);
+	for(int kind = 0; kind < Terrain::NUM_DERIVED; kind++) {
+		tilesPerBlock = max(tilesPerBlock,
+							tilesFillingPages(derivedSize[kind] * TILE_CELLS,
+											  pageSize));
+	}
+	heightBlockBytes = tilesPerBlock * TILE_CELLS * heightSize;
+	blockBytes = heightBlockBytes;
+	for(int kind = 0; kind < Terrain::NUM_DERIVED; kind++) {
+		derivedBlockBytes[kind] =
+			tilesPerBlock * TILE_CELLS * derivedSize[kind];
+		blockBytes += derivedBlockBytes[kind];
+	}
+	maxBlocks = max(16, (int)(residentBytes / blockBytes));
+
+	for(size_t tile = 0; tile < rankTiles.size(); tile++) {
+		rankTiles[terrain->tileBase[tile] / TILE_CELLS] = (int)tile;
+	}
+	int numBlocks =
+		(int)((rankTiles.size() + tilesPerBlock - 1) / tilesPerBlock);
+	blockFlags.resize(numBlocks, 0);
+	lruPositions.resize(numBlocks);
+
+	//Reserve address space for the derived data, without committing memory
+	for(int kind = 0; kind < Terrain::NUM_DERIVED; kind++) {
+		derivedBytes[kind] = terrain->cellCount * derivedSize[kind];
+		void* memory = mmap(NULL, derivedBytes[kind], PROT_READ | PROT_WRITE,
+							MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+							-1, 0);
+		assert(memory != MAP_FAILED || !"Could not map derived data");
+		derivedMemory[kind] = (char*)memory;
+	}
+}
+
+TerrainStream::~TerrainStream() {
+	if (prefetcher.joinable()) {
+		{
+			lock_guard<mutex> guard(prefetchLock);
+			stopping = true;
+		}
+		prefetchWake.notify_one();
+		prefetcher.join();
+	}
+	close(fd);
+	munmap(file, fileBytes);
+	for(int kind = 0; kind < Terrain::NUM_DERIVED; kind++) {
+		munmap(derivedMemory[kind], derivedBytes[kind]);
+	}
+}
+
+Terrain* TerrainStream::open(const char* filename, size_t residentBytes,
+							 NormalFormat normalFormat) {
+	int fd = ::open(filename, O_RDONLY);
+	assert(fd >= 0 || !"Could not find file");
+	struct stat info;
+	fstat(fd, &info);
+	size_t fileBytes = (size_t)info.st_size;
+
+	FileHeader header;
+	if (fileBytes < HEADER_BYTES ||
+		pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+		memcmp(header.magic, "TERH", 4) != 0 ||
+		header.version != FILE_VERSION ||
+		header.tileSize != Terrain::TILE_SIZE ||
+		header.width <= 0 || header.length <= 0) {
+		close(fd);
+		return NULL;
+	}
+
+	Terrain* t = new Terrain();
+	t->init(header.width, header.length, normalFormat, LAYOUT_TILED, NULL);
+	size_t heightSize = header.heightFormat == HEIGHTS_FLOAT ? sizeof(float)
+		: sizeof(unsigned short);
+	if (fileBytes < HEADER_BYTES + heightSize * t->cellCount) {
+		close(fd);
+		delete t;
+		return NULL;
+	}
+
+	//A private mapping lets the terrain be edited without touching the file
+	void* memory = mmap(NULL, fileBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+						fd, 0);
+	assert(memory != MAP_FAILED || !"Could not map file");
+	char* file = (char*)memory;
+	madvise(file + HEADER_BYTES, fileBytes - HEADER_BYTES, MADV_RANDOM);
+
+	if (header.heightFormat == HEIGHTS_FLOAT) {
+		t->hs = (float*)(file + HEADER_BYTES);
+	}
+	else {
+		t->qhs = (unsigned short*)(file + HEADER_BYTES);
+		t->heightScale = header.heightScale;
+		t->heightOffset = header.heightOffset;
+	}
+	t->lowestHeight = header.lowestHeight;
+	t->highestHeight = header.highestHeight;
+	t->isHeightRangeKnown = true;
+
+	TerrainStream* stream =
+		new TerrainStream(t, fd, file, fileBytes, residentBytes);
+	char* normals = stream->derivedMemory[Terrain::DERIVED_NORMALS];
+	switch(normalFormat) {
+		case NORMALS_FLOAT:
+			t->normals = (Vec3f*)normals;
+			break;
+		case NORMALS_OCT32:
+			t->octNormals32 = (unsigned int*)normals;
+			break;
+		case NORMALS_OCT16:
+			t->octNormals16 = (unsigned short*)normals;
+			break;
+	}
+	t->occlusion =
+		(unsigned char*)stream->derivedMemory[Terrain::DERIVED_OCCLUSION];
+	t->shadows =
+		(unsigned char*)stream->derivedMemory[Terrain::DERIVED_SHADOWS];
+	t->gradients =
+		(unsigned int*)stream->derivedMemory[Terrain::DERIVED_GRADIENTS];
+	t->stream = stream;
+	return t;
+}
+
+void TerrainStream::save(Terrain* t, const char* filename) {
+	ofstream output;
+	output.open(filename, ofstream::binary);
+	assert(!output.fail() || !"Could not create file");
+
+	FileHeader header;
+	memcpy(header.magic, "TERH", 4);
+	header.version = FILE_VERSION;
+	header.width = t->width();
+	header.length = t->length();
+	header.tileSize = Terrain::TILE_SIZE;
+	header.heightFormat = t->getHeightFormat();
+	header.heightScale = t->heightScale;
+	header.heightOffset = t->heightOffset;
+	t->heightRange(header.lowestHeight, header.highestHeight);
+	vector<char> padding(HEADER_BYTES, 0);
+	memcpy(&padding[0], &header, sizeof(header));
+	output.write(&padding[0], HEADER_BYTES);
+
+	//Write the tiles in Z-order, as a tiled terrain of the same size stores
+	//them, with zeros past the edges of the terrain
+	Terrain layout;
+	layout.init(t->width(), t->length(), NORMALS_OCT16, LAYOUT_TILED, NULL);
+	vector<int> order(layout.cellCount / TILE_CELLS);
+	for(size_t tile = 0; tile < order.size(); tile++) {
+		order[layout.tileBase[tile] / TILE_CELLS] = (int)tile;
+	}
+
+	vector<float> floats(TILE_CELLS);
+	vector<unsigned short> levels(TILE_CELLS);
+	vector<float> row(Terrain::TILE_SIZE);
+	for(size_t i = 0; i < order.size(); i++) {
+		int x0 = order[i] % layout.tilesX * Terrain::TILE_SIZE;
+		int z0 = order[i] / layout.tilesX * Terrain::TILE_SIZE;
+		int x1 = min(x0 + Terrain::TILE_SIZE, t->width());
+		int z1 = min(z0 + Terrain::TILE_SIZE, t->length());
+		fill(floats.begin(), floats.end(), 0.0f);
+		fill(levels.begin(), levels.end(), 0);
+		for(int z = z0; z < z1; z++) {
+			t->readHeights(z, x0, x1, &row[0]);
+			for(int x = x0; x < x1; x++) {
+				int j = layout.cellIndex(x, z) - layout.tileBase[order[i]];
+				floats[j] = row[x - x0];
+				levels[j] = t->quantizeHeight(row[x - x0]);
+			}
+		}
+
+		if (header.heightFormat == HEIGHTS_FLOAT) {
+			output.write((const char*)&floats[0], sizeof(float) * TILE_CELLS);
+		}
+		else {
+			output.write((const char*)&levels[0],
+						 sizeof(unsigned short) * TILE_CELLS);
+		}
+	}
+}
+
+void TerrainStream::touchBlock(int block, bool write) {
+	unsigned char &flags = blockFlags[block];
+	lastBlock = block;
+	if (flags & BLOCK_PINNED) {
+		return;
+	}
+
+	if (flags & BLOCK_RESIDENT) {
+		lru.splice(lru.begin(), lru, lruPositions[block]);
+	}
+	else {
+		flags |= BLOCK_RESIDENT;
+		lru.push_front(block);
+		lruPositions[block] = lru.begin();
+		while ((int)lru.size() > maxBlocks) {
+			evict(lru.back());
+		}
+	}
+
+	if (write) {
+		lru.erase(lruPositions[block]);
+		flags |= BLOCK_PINNED;
+	}
+}
+
+void TerrainStream::evict(int block) {
+	lru.erase(lruPositions[block]);
+	blockFlags[block] = 0;
+	discard(file + HEADER_BYTES + block * heightBlockBytes, heightBlockBytes);
+	for(int kind = 0; kind < Terrain::NUM_DERIVED; kind++) {
+		discard(derivedMemory[kind] + block * derivedBlockBytes[kind],
+				derivedBlockBytes[kind]);
+	}
+}
+
+void TerrainStream::discard(char* begin, size_t bytes) {
+	//Round inwards, so as not to drop pages shared with other blocks
+	size_t start = ((size_t)begin + pageSize - 1) / pageSize * pageSize;
+	size_t end = ((size_t)begin + bytes) / pageSize * pageSize;
+	if (start < end) {
+		madvise((void*)start, end - start, MADV_DONTNEED);
+	}
+}
+
+vector<int> TerrainStream::markDerived(int tile, Terrain::Derived kind) {
+	int block = blockOf(tile);
+	blockFlags[block] |= BLOCK_DERIVED << kind;
+	vector<int> tiles;
+	int end = min((int)rankTiles.size(), (block + 1) * tilesPerBlock);
+	for(int rank = block * tilesPerBlock; rank < end; rank++) {
+		tiles.push_back(rankTiles[rank]);
+	}
+	return tiles;
+}
+
+void TerrainStream::invalidateDerived(const TerrainRect &rect,
+									  Terrain::Derived kind) {
+	if (rect.isEmpty()) {
+		return;
+	}
+	for(int tz = rect.z0 / Terrain::TILE_SIZE;
+		tz <= (rect.z1 - 1) / Terrain::TILE_SIZE; tz++) {
+		for(int tx = rect.x0 / Terrain::TILE_SIZE;
+			tx <= (rect.x1 - 1) / Terrain::TILE_SIZE; tx++) {
+			blockFlags[blockOf(tz * terrain->tilesX + tx)] &=
+				~(BLOCK_DERIVED << kind);
+		}
+	}
+}
+
+void TerrainStream::prefetch(float x, float z, float dx, float dz) {
+	lock_guard<mutex> guard(prefetchLock);
+	//Blocks that weren't read in time were asked for on an older guess at
+	//the path, and may not be needed any more
+	for(size_t i = 0; i < prefetchQueue.size(); i++) {
+		blockFlags[prefetchQueue[i]] &= ~BLOCK_PREFETCHED;
+	}
+
+	//Walk the path half a tile at a time, so as not to skip any tiles near
+	//it
+	vector<int> blocks;
+	TerrainRect bounds = terrain->bounds();
+	int steps = (int)(sqrtf(dx * dx + dz * dz) / (Terrain::TILE_SIZE / 2)) + 1;
+	for(int i = 0; i <= steps; i++) {
+		int px = (int)floorf(x + dx * i / steps);
+		int pz = (int)floorf(z + dz * i / steps);
+		TerrainRect rect = TerrainRect(px, pz, px + 1, pz + 1)
+			.expanded(Terrain::TILE_SIZE).clipped(bounds);
+		if (rect.isEmpty()) {
+			continue;
+		}
+		for(int tz = rect.z0 / Terrain::TILE_SIZE;
+			tz <= (rect.z1 - 1) / Terrain::TILE_SIZE; tz++) {
+			for(int tx = rect.x0 / Terrain::TILE_SIZE;
+				tx <= (rect.x1 - 1) / Terrain::TILE_SIZE; tx++) {
+				int block = blockOf(tz * terrain->tilesX + tx);
+				if (!(blockFlags[block] & (BLOCK_RESIDENT | BLOCK_PINNED |
+										   BLOCK_PREFETCHED))) {
+					blockFlags[block] |= BLOCK_PREFETCHED;
+					blocks.push_back(block);
+				}
+			}
+		}
+	}
+
+	prefetchQueue.assign(blocks.rbegin(), blocks.rend());
+	if (prefetchQueue.empty()) {
+		return;
+	}
+	if (!prefetcher.joinable()) {
+		prefetcher = thread(&TerrainStream::prefetchMain, this);
+	}
+	prefetchWake.notify_one();
+}
+
+void TerrainStream::prefetchMain() {
+	vector<char> buffer(heightBlockBytes);
+	unique_lock<mutex> guard(prefetchLock);
+	while (true) {
+		prefetchWake.wait(guard, [this] {
+			return stopping || !prefetchQueue.empty();
+		});
+		if (stopping) {
+			return;
+		}
+		int block = prefetchQueue.back();
+		prefetchQueue.pop_back();
+		guard.unlock();
+
+		//Reading the block puts it in the system's cache, which the mapping
+		//shares.  If reading fails, leave blocks to be read when they're used.
+		if (pread(fd, &buffer[0], heightBlockBytes,
+				  HEADER_BYTES + block * heightBlockBytes) < 0) {
+			return;
+		}
+		guard.lock();
+	}
+}
+
+void TerrainStream::reserve(size_t bytes) {
+	size_t available = bytes < budgetBytes ? budgetBytes - bytes : 0;
+	maxBlocks = max(16, (int)(available / blockBytes));
+	while ((int)lru.size() > maxBlocks) {
+		evict(lru.back());
+	}
+}
+
+int TerrainStream::residentBlocks() {
+	int count = 0;
+	for(size_t i = 0; i < blockFlags.size(); i++) {
+		if (blockFlags[i] & (BLOCK_RESIDENT | BLOCK_PINNED)) {
+			count++;
+		}
+	}
+	return count;
+}
+
+void saveTerrain(Terrain* t, const char* filename) {
+	TerrainStream::save(t, filename);
+}
+
+Terrain* mapTerrain(const char* filename, size_t residentBytes,
+					NormalFormat normalFormat) {
+	return TerrainStream::open(filename, residentBytes, normalFormat);
+}
+
+
+
+
+
+
+
+
+
+
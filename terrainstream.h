@@ -0,0 +1,203 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef TERRAIN_STREAM_H_INCLUDED
+#define TERRAIN_STREAM_H_INCLUDED
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "terrain.h"
+
+/* Pages the tiles of a terrain mapped from a file in and out of memory.
+ *
+ * The file starts with a header padded to HEADER_BYTES, followed by the
+ * heights in the order of a tiled terrain (see Terrain::cellIndex), in the
+ * byte order of the machine that wrote it.  The heights are mapped straight
+ * from the file, and the data derived from them, such as the normals, the
+ * ambient occlusion and the shadows, from anonymous memory, so nothing is
+ * read until it is used.  Tiles are tracked in blocks of consecutive tiles
+ * whose heights and each kind of derived data fill whole pages, and once
+ * more blocks than the budget allows have been used, the least recently used
+ * one is dropped from memory, and its derived data is recomputed when it is
+ * next used.
+ *
+ * Edits aren't written back to the file.  A block whose heights were written
+ * stays in memory for as long as the terrain exists, so that the edits aren't
+ * lost.
+ *
+ * Blocks that are about to be needed can be prefetched: a background thread
+ * reads them from the file into the system's cache, so that the first use of
+ * a block only has to map pages that are already in memory, rather than wait
+ * for the disk.
+ */
+class TerrainStream {
+	private:
+		//The flags of each block
+		enum {
+			BLOCK_RESIDENT = 1, //Has been used since it was last dropped
+			BLOCK_PINNED = 2,   //Has been written, and is never dropped
+			BLOCK_PREFETCHED = 4, //Has been read by the prefetch thread, or
+			                      //is waiting to be, since it was last
+			                      //dropped
+			BLOCK_DERIVED = 8 //Has up-to-date derived data of the first kind;
+			                  //kind d uses BLOCK_DERIVED << d
+		};
+
+		Terrain* terrain;
+		int fd; //The file, kept open for the prefetch thread
+		char* file;
+		size_t fileBytes;
+		char* derivedMemory[Terrain::NUM_DERIVED]; //Each kind of derived data
+		size_t derivedBytes[Terrain::NUM_DERIVED];
+		size_t pageSize;
+
+		int tilesPerBlock;
+		size_t heightBlockBytes; //The bytes of heights of each block
+		//The bytes of each kind of derived data of each block
+		size_t derivedBlockBytes[Terrain::NUM_DERIVED];
+		size_t blockBytes; //The bytes of heights and derived data of each block
+		size_t budgetBytes; //The residentBytes the terrain was mapped with
+		int maxBlocks;
+		std::vector<int> rankTiles; //The tile stored at each position in the
+		                            //file
+		std::vector<unsigned char> blockFlags;
+		//The resident blocks that aren't pinned, most recently used first
+		std::list<int> lru;
+		std::vector<std::list<int>::iterator> lruPositions;
+		int lastBlock; //The most recently used block
+
+		//The prefetch thread, which is started by the first prefetch
+		std::thread prefetcher;
+		std::mutex prefetchLock;
+		std::condition_variable prefetchWake; //Signalled when blocks are
+		                                      //queued or the stream closes
+		std::vector<int> prefetchQueue; //The blocks waiting to be read, the
+		                                //next one last
+		bool stopping;
+
+		TerrainStream(const TerrainStream &other);
+		void operator=(const TerrainStream &other);
+
+		TerrainStream(Terrain* terrain2, int fd2, char* file2,
+					  size_t fileBytes2, size_t residentBytes);
+		int blockOf(int tile) {
+			return terrain->tileBase[tile] /
+				(Terrain::TILE_SIZE * Terrain::TILE_SIZE) / tilesPerBlock;
+		}
+		void touchBlock(int block, bool write);
+		//Drops the heights and derived data of a block from memory
+		void evict(int block);
+		//Gives back to the system the whole pages in [begin, begin + bytes)
+		void discard(char* begin, size_t bytes);
+		void prefetchMain();
+	public:
+		//The size of the file header, which keeps the heights page-aligned
+		static const size_t HEADER_BYTES = 65536;
+
+		~TerrainStream();
+
+		//Maps the terrain in the given file, keeping the heights and derived
+		//data of about residentBytes worth of tiles in memory at once.  Returns
+		//NULL if the file isn't a terrain file.
+		static Terrain* open(const char* filename, size_t residentBytes,
+							 NormalFormat normalFormat);
+		//Writes the heights of t to the given file
+		static void save(Terrain* t, const char* filename);
+
+		//Notes that the given tile is about to be read, or written
+		void touch(int tile, bool write) {
+			int block = blockOf(tile);
+			if (block != lastBlock ||
+				(write && !(blockFlags[block] & BLOCK_PINNED))) {
+				touchBlock(block, write);
+			}
+		}
+
+		//Returns whether the given kind of derived data of the given tile is
+		//up to date
+		bool hasDerived(int tile, Terrain::Derived kind) {
+			return (blockFlags[blockOf(tile)] & (BLOCK_DERIVED << kind)) != 0;
+		}
+
+		//Marks the given kind of derived data of the block holding the given
+		//tile as up to date, and returns the tiles of that block, whose data
+		//the caller must then compute
+		std::vector<int> markDerived(int tile, Terrain::Derived kind);
+
+		//Marks the given kind of derived data of the tiles overlapping rect
+		//as out of date
+		void invalidateDerived(const TerrainRect &rect, Terrain::Derived kind);
+
+		//Queues the blocks of the tiles within a tile of the segment from
+		//(x, z) to (x + dx, z + dz) that aren't in memory to be read in the
+		//background, nearest to (x, z) first.  Blocks still waiting from an
+		//earlier call are dropped from the queue.
+		void prefetch(float x, float z, float dx, float dz);
+
+		//Returns the bytes of heights, derived data and reserved data the
+		//terrain was mapped to keep in memory
+		size_t budget() {
+			return budgetBytes;
+		}
+
+		//Sets aside bytes of the budget for data kept elsewhere for the
+		//terrain, such as the vertices of a TerrainLod, dropping blocks until
+		//the rest fit.  Each call replaces the last.
+		void reserve(size_t bytes);
+
+		//Returns the number of blocks in memory, counting pinned ones
+		int residentBlocks();
+
+		//Returns the bytes of heights and derived data of the blocks in
+		//memory
+		size_t residentBytes() {
+			return residentBlocks() * blockBytes;
+		}
+};
+
+//Writes the heights of t to filename, in the format mapTerrain reads
+void saveTerrain(Terrain* t, const char* filename);
+
+//Maps the terrain written by saveTerrain to filename, keeping about
+//residentBytes of it in memory at once.  Returns NULL if the file isn't a
+//terrain file.
+Terrain* mapTerrain(const char* filename, size_t residentBytes,
+					NormalFormat normalFormat = NORMALS_OCT16);
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,126 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+
+#include <algorithm>
+
+#include "threadpool.h"
+
+using namespace std;
+
+namespace {
+	//How many bands to cut a loop into per thread, so that threads which
+	//finish early can pick up more work
+	const int BANDS_PER_THREAD = 4;
+}
+
+ThreadPool::ThreadPool(int numThreads) :
+	body(NULL), begin(0), end(0), numBands(0), nextBand(0), finishedBands(0),
+	generation(0), stopping(false) {
+	if (numThreads <= 0) {
+		numThreads = max(1, (int)thread::hardware_concurrency());
+	}
+	for(int i = 1; i < numThreads; i++) {
+		workers.push_back(thread(&ThreadPool::workerMain, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for(size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+void ThreadPool::workerMain() {
+	unique_lock<mutex> guard(lock);
+	unsigned long seen = generation;
+	while (true) {
+		wake.wait(guard, [&] { return stopping || generation != seen; });
+		if (stopping) {
+			return;
+		}
+		seen = generation;
+		runBands(guard);
+	}
+}
+
+void ThreadPool::runBands(unique_lock<mutex> &guard) {
+	while (nextBand < numBands) {
+		int band = nextBand++;
+		int count = end - begin;
+		int bandBegin = begin + (int)((long long)count * band / numBands);
+		int bandEnd = begin + (int)((long long)count * (band + 1) / numBands);
+		const function<void(int, int)>* f = body;
+
+		guard.unlock();
+		(*f)(bandBegin, bandEnd);
+		guard.lock();
+
+		if (++finishedBands == numBands) {
+			done.notify_all();
+		}
+	}
+}
+
+void ThreadPool::parallelFor(int begin_, int end_, int minBand,
+							 const function<void(int, int)> &body_) {
+	int count = end_ - begin_;
+	if (count <= 0) {
+		return;
+	}
+	int bands = min(size() * BANDS_PER_THREAD, count / max(minBand, 1));
+	unique_lock<mutex> caller(callerLock, try_to_lock);
+	if (bands <= 1 || !caller.owns_lock()) {
+		body_(begin_, end_);
+		return;
+	}
+
+	unique_lock<mutex> guard(lock);
+	body = &body_;
+	begin = begin_;
+	end = end_;
+	numBands = bands;
+	nextBand = 0;
+	finishedBands = 0;
+	generation++;
+	wake.notify_all();
+
+	runBands(guard);
+	done.wait(guard, [&] { return finishedBands == numBands; });
+	body = NULL;
+}
+
+
+
+
+
+
+
+
+
@@ -0,0 +1,90 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef THREAD_POOL_H_INCLUDED
+#define THREAD_POOL_H_INCLUDED
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//A fixed set of worker threads that split loops over a range of indices
+class ThreadPool {
+	private:
+		std::vector<std::thread> workers;
+		std::mutex lock;
+		std::condition_variable wake; //Signalled when a loop starts or the
+		                              //pool shuts down
+		std::condition_variable done; //Signalled when a band finishes
+		std::mutex callerLock; //Held by the thread running parallelFor
+
+		//The loop being run
+		const std::function<void(int, int)>* body;
+		int begin;
+		int end;
+		int numBands;
+		int nextBand;
+		int finishedBands;
+		unsigned long generation; //Incremented for every loop
+		bool stopping;
+
+		ThreadPool(const ThreadPool &other);
+		void operator=(const ThreadPool &other);
+
+		void workerMain();
+		//Runs bands of the current loop until none are left.  Expects lock
+		//to be held by guard.
+		void runBands(std::unique_lock<std::mutex> &guard);
+	public:
+		//Starts a pool that runs loops on numThreads threads, counting the
+		//calling thread.  If numThreads is 0, uses one per hardware thread.
+		explicit ThreadPool(int numThreads = 0);
+		~ThreadPool();
+
+		//Returns the number of threads loops run on, counting the caller
+		int size() {
+			return (int)workers.size() + 1;
+		}
+
+		//Calls body(bandBegin, bandEnd) for contiguous bands that together
+		//cover begin <= i < end, and returns once every band has finished.
+		//Bands are at least minBand indices long.  Loops started while
+		//another one is running, such as from inside a band, run serially on
+		//the calling thread.
+		void parallelFor(int begin, int end, int minBand,
+						 const std::function<void(int, int)> &body);
+};
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,425 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <queue>
+#include <string>
+#include <utility>
+
+#include "terrain.h"
+#include "tinmesh.h"
+
+using namespace std;
+
+namespace {
+	/* A triangle of the mesh being built.  Its vertices go counterclockwise
+	 * in the (x, z) plane, and adjacent[i] is the triangle across the edge
+	 * opposite vertices[i], or -1 on the border.
+	 */
+	struct TinTriangle {
+		int vertices[3];
+		int adjacent[3];
+		//The grid point furthest from the triangle, and how far it is
+		int candidateX;
+		int candidateZ;
+		float error;
+		int version; //Incremented whenever the triangle changes
+	};
+
+	class Simplifier {
+		private:
+			int w;
+			int l;
+			vector<float> heights;
+			vector<int> xs;
+			vector<int> zs;
+			vector<TinTriangle> triangles;
+			//Candidates by error, with the version of their triangle
+			priority_queue<pair<float, pair<int, int> > > queue;
+			vector<int> changed; //The triangles changed by an insertion
+			vector<pair<int, int> > edges; //Edges left to legalize
+
+			//Returns twice the signed area of the triangle (a, b, c), which
+			//is positive if it is counterclockwise
+			long long orient(int ax, int az, int bx, int bz, int cx, int cz) {
+				return (long long)(bx - ax) * (cz - az) -
+					(long long)(bz - az) * (cx - ax);
+			}
+
+			long long orient(int a, int b, int px, int pz) {
+				return orient(xs[a], zs[a], xs[b], zs[b], px, pz);
+			}
+
+			//Returns whether d is strictly inside the circle through the
+			//counterclockwise triangle (a, b, c).  The values stay within a
+			//long long for coordinates below 16384.
+			bool inCircle(int a, int b, int c, int d) {
+				long long adx = xs[a] - xs[d];
+				long long adz = zs[a] - zs[d];
+				long long bdx = xs[b] - xs[d];
+				long long bdz = zs[b] - zs[d];
+				long long cdx = xs[c] - xs[d];
+				long long cdz = zs[c] - zs[d];
+				return (adx * adx + adz * adz) * (bdx * cdz - bdz * cdx) +
+					(bdx * bdx + bdz * bdz) * (cdx * adz - cdz * adx) +
+					(cdx * cdx + cdz * cdz) * (adx * bdz - adz * bdx) > 0;
+			}
+
+			int addVertex(int x, int z) {
+				xs.push_back(x);
+				zs.push_back(z);
+				return (int)xs.size() - 1;
+			}
+
+			int addTriangle() {
+				triangles.push_back(TinTriangle());
+				triangles.back().version = 0;
+				return (int)triangles.size() - 1;
+			}
+
+			void setTriangle(int t, int a, int b, int c, int adjA, int adjB,
+							 int adjC) {
+				TinTriangle &tri = triangles[t];
+				tri.vertices[0] = a;
+				tri.vertices[1] = b;
+				tri.vertices[2] = c;
+				tri.adjacent[0] = adjA;
+				tri.adjacent[1] = adjB;
+				tri.adjacent[2] = adjC;
+				tri.version++;
+				changed.push_back(t);
+			}
+
+			//Points the neighbour t across from oldT at newT instead
+			void replaceAdjacent(int t, int oldT, int newT) {
+				if (t < 0) {
+					return;
+				}
+				for(int i = 0; i < 3; i++) {
+					if (triangles[t].adjacent[i] == oldT) {
+						triangles[t].adjacent[i] = newT;
+					}
+				}
+			}
+
+			//Finds the grid point furthest from triangle t, and queues it
+			void scan(int t);
+			//Adds the grid point (x, z), which lies in triangle t, to the mesh
+			void insert(int t, int x, int z);
+			//Flips edges until the triangles around the new vertex are
+			//Delaunay
+			void legalize();
+		public:
+			explicit Simplifier(Terrain* t);
+			void run(float maxError);
+			TinMesh* mesh(Terrain* t);
+	};
+
+	Simplifier::Simplifier(Terrain* t) {
+		w = t->width();
+		l = t->length();
+		heights.resize((size_t)w * l);
+		for(int z = 0; z < l; z++) {
+			t->readHeights(z, 0, w, &heights[(size_t)z * w]);
+		}
+
+		int v0 = addVertex(0, 0);
+		int v1 = addVertex(w - 1, 0);
+		int v2 = addVertex(w - 1, l - 1);
+		int v3 = addVertex(0, l - 1);
+		int t0 = addTriangle();
+		int t1 = addTriangle();
+		setTriangle(t0, v0, v1, v2, -1, t1, -1);
+		setTriangle(t1, v0, v2, v3, -1, -1, t0);
+	}
+
+	void Simplifier::scan(int t) {
+		TinTriangle &tri = triangles[t];
+		int a = tri.vertices[0];
+		int b = tri.vertices[1];
+		int c = tri.vertices[2];
+		float ya = heights[(size_t)zs[a] * w + xs[a]];
+		float yb = heights[(size_t)zs[b] * w + xs[b]];
+		float yc = heights[(size_t)zs[c] * w + xs[c]];
+		float area = (float)orient(a, b, xs[c], zs[c]);
+
+		tri.error = 0.0f;
+		tri.candidateX = xs[a];
+		tri.candidateZ = zs[a];
+		int x0 = min(min(xs[a], xs[b]), xs[c]);
+		int x1 = max(max(xs[a], xs[b]), xs[c]);
+		int z0 = min(min(zs[a], zs[b]), zs[c]);
+		int z1 = max(max(zs[a], zs[b]), zs[c]);
+		for(int z = z0; z <= z1; z++) {
+			for(int x = x0; x <= x1; x++) {
+				long long wa = orient(b, c, x, z);
+				long long wb = orient(c, a, x, z);
+				long long wc = orient(a, b, x, z);
+				//Skip points outside the triangle, and its own vertices
+				if (wa < 0 || wb < 0 || wc < 0 ||
+					(wa == 0) + (wb == 0) + (wc == 0) >= 2) {
+					continue;
+				}
+				float y = (wa * ya + wb * yb + wc * yc) / area;
+				float error = fabsf(heights[(size_t)z * w + x] - y);
+				if (error > tri.error) {
+					tri.error = error;
+					tri.candidateX = x;
+					tri.candidateZ = z;
+				}
+			}
+		}
+		queue.push(make_pair(tri.error, make_pair(t, tri.version)));
+	}
+
+	void Simplifier::insert(int t, int x, int z) {
+		int p = addVertex(x, z);
+		TinTriangle old = triangles[t];
+		int edge = -1;
+		for(int i = 0; i < 3; i++) {
+			if (orient(old.vertices[(i + 1) % 3], old.vertices[(i + 2) % 3],
+					   x, z) == 0) {
+				edge = i;
+			}
+		}
+
+		if (edge < 0) {
+			//Split t into three around p
+			int a = old.vertices[0];
+			int b = old.vertices[1];
+			int c = old.vertices[2];
+			int t1 = addTriangle();
+			int t2 = addTriangle();
+			setTriangle(t, a, b, p, t1, t2, old.adjacent[2]);
+			setTriangle(t1, b, c, p, t2, t, old.adjacent[0]);
+			setTriangle(t2, c, a, p, t, t1, old.adjacent[1]);
+			replaceAdjacent(old.adjacent[0], t, t1);
+			replaceAdjacent(old.adjacent[1], t, t2);
+			edges.push_back(make_pair(t, 2));
+			edges.push_back(make_pair(t1, 2));
+			edges.push_back(make_pair(t2, 2));
+		}
+		else {
+			//Split t, and the triangle u on the other side of the edge p lies
+			//on, into two each
+			int a = old.vertices[edge];
+			int b = old.vertices[(edge + 1) % 3];
+			int c = old.vertices[(edge + 2) % 3];
+			int u = old.adjacent[edge];
+			int tB = addTriangle();
+			int uB = u >= 0 ? addTriangle() : -1;
+			setTriangle(t, a, b, p, uB, tB, old.adjacent[(edge + 2) % 3]);
+			setTriangle(tB, a, p, c, u, old.adjacent[(edge + 1) % 3], t);
+			replaceAdjacent(old.adjacent[(edge + 1) % 3], t, tB);
+			edges.push_back(make_pair(t, 2));
+			edges.push_back(make_pair(tB, 1));
+
+			if (u >= 0) {
+				TinTriangle oldU = triangles[u];
+				int j = 0;
+				while (oldU.adjacent[j] != t) {
+					j++;
+				}
+				int d = oldU.vertices[j];
+				//oldU runs d, c, b
+				setTriangle(u, d, c, p, tB, uB, oldU.adjacent[(j + 2) % 3]);
+				setTriangle(uB, d, p, b, t, oldU.adjacent[(j + 1) % 3], u);
+				replaceAdjacent(oldU.adjacent[(j + 1) % 3], u, uB);
+				edges.push_back(make_pair(u, 2));
+				edges.push_back(make_pair(uB, 1));
+			}
+		}
+		legalize();
+	}
+
+	void Simplifier::legalize() {
+		while (!edges.empty()) {
+			int t = edges.back().first;
+			int i = edges.back().second;
+			edges.pop_back();
+
+			int n = triangles[t].adjacent[i];
+			if (n < 0) {
+				continue;
+			}
+			TinTriangle tri = triangles[t];
+			TinTriangle other = triangles[n];
+			int j = 0;
+			while (other.adjacent[j] != t) {
+				j++;
+			}
+			int p = tri.vertices[i];
+			int b = tri.vertices[(i + 1) % 3];
+			int c = tri.vertices[(i + 2) % 3];
+			int d = other.vertices[j];
+			if (!inCircle(p, b, c, d)) {
+				continue;
+			}
+
+			//Flip the edge (b, c) to (p, d)
+			int outerT1 = tri.adjacent[(i + 2) % 3];
+			int outerT2 = tri.adjacent[(i + 1) % 3];
+			int outerN1 = other.adjacent[(j + 1) % 3];
+			int outerN2 = other.adjacent[(j + 2) % 3];
+			setTriangle(t, p, b, d, outerN1, n, outerT1);
+			setTriangle(n, p, d, c, outerN2, outerT2, t);
+			replaceAdjacent(outerN1, n, t);
+			replaceAdjacent(outerT2, t, n);
+			edges.push_back(make_pair(t, 0));
+			edges.push_back(make_pair(n, 0));
+		}
+	}
+
+	void Simplifier::run(float maxError) {
+		for(size_t t = 0; t < triangles.size(); t++) {
+			scan((int)t);
+		}
+		changed.clear();
+
+		while (!queue.empty()) {
+			float error = queue.top().first;
+			int t = queue.top().second.first;
+			int version = queue.top().second.second;
+			queue.pop();
+			if (version != triangles[t].version) {
+				continue;
+			}
+			if (error <= maxError) {
+				break;
+			}
+
+			insert(t, triangles[t].candidateX, triangles[t].candidateZ);
+			sort(changed.begin(), changed.end());
+			changed.erase(unique(changed.begin(), changed.end()),
+						  changed.end());
+			for(size_t i = 0; i < changed.size(); i++) {
+				scan(changed[i]);
+			}
+			changed.clear();
+		}
+	}
+
+	TinMesh* Simplifier::mesh(Terrain* t) {
+		TinMesh* mesh = new TinMesh();
+		mesh->width = w;
+		mesh->length = l;
+		for(size_t i = 0; i < xs.size(); i++) {
+			mesh->vertices.push_back(
+				Vec3f((float)xs[i], heights[(size_t)zs[i] * w + xs[i]],
+					  (float)zs[i]));
+			mesh->normals.push_back(t->getNormal(xs[i], zs[i]));
+		}
+		//The grid strips are clockwise in the (x, z) plane
+		for(size_t i = 0; i < triangles.size(); i++) {
+			mesh->triangles.push_back(triangles[i].vertices[0]);
+			mesh->triangles.push_back(triangles[i].vertices[2]);
+			mesh->triangles.push_back(triangles[i].vertices[1]);
+		}
+		return mesh;
+	}
+}
+
+TinMesh* simplifyTerrain(Terrain* t, float maxError) {
+	assert(t->width() >= 2 && t->length() >= 2);
+	Simplifier simplifier(t);
+	simplifier.run(max(maxError, 0.0f));
+	return simplifier.mesh(t);
+}
+
+void saveTin(const TinMesh* mesh, const char* filename) {
+	ofstream output;
+	output.open(filename);
+	assert(!output.fail() || !"Could not create file");
+	output.precision(9);
+
+	output << "TIN 1\n" << mesh->width << " " << mesh->length << "\n";
+	output << mesh->vertices.size() << "\n";
+	for(size_t i = 0; i < mesh->vertices.size(); i++) {
+		const Vec3f &v = mesh->vertices[i];
+		const Vec3f &n = mesh->normals[i];
+		output << v[0] << " " << v[1] << " " << v[2] << " "
+			   << n[0] << " " << n[1] << " " << n[2] << "\n";
+	}
+	output << mesh->triangles.size() / 3 << "\n";
+	for(size_t i = 0; i < mesh->triangles.size(); i += 3) {
+		output << mesh->triangles[i] << " " << mesh->triangles[i + 1] << " "
+			   << mesh->triangles[i + 2] << "\n";
+	}
+}
+
+TinMesh* loadTin(const char* filename) {
+	ifstream input;
+	input.open(filename);
+	assert(!input.fail() || !"Could not find file");
+
+	string magic;
+	int version = 0;
+	input >> magic >> version;
+	if (magic != "TIN" || version != 1) {
+		return NULL;
+	}
+
+	TinMesh* mesh = new TinMesh();
+	size_t numVertices = 0;
+	input >> mesh->width >> mesh->length >> numVertices;
+	mesh->vertices.resize(numVertices);
+	mesh->normals.resize(numVertices);
+	for(size_t i = 0; i < numVertices; i++) {
+		Vec3f &v = mesh->vertices[i];
+		Vec3f &n = mesh->normals[i];
+		input >> v[0] >> v[1] >> v[2] >> n[0] >> n[1] >> n[2];
+	}
+	size_t numTriangles = 0;
+	input >> numTriangles;
+	mesh->triangles.resize(3 * numTriangles);
+	for(size_t i = 0; i < mesh->triangles.size(); i++) {
+		input >> mesh->triangles[i];
+	}
+
+	bool valid = !input.fail();
+	for(size_t i = 0; valid && i < mesh->triangles.size(); i++) {
+		valid = mesh->triangles[i] >= 0 &&
+			mesh->triangles[i] < (int)numVertices;
+	}
+	if (!valid) {
+		delete mesh;
+		return NULL;
+	}
+	return mesh;
+}
+
+
+
+
+
+
+
+
+
+
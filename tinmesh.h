@@ -0,0 +1,66 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#ifndef TIN_MESH_H_INCLUDED
+#define TIN_MESH_H_INCLUDED
+
+#include <vector>
+
+#include "vec3f.h"
+
+class Terrain;
+
+//A triangulated irregular network: a mesh with vertices at some of the grid
+//points of a terrain, and larger triangles where the terrain is flatter
+struct TinMesh {
+	int width; //The size of the terrain the mesh was made from
+	int length;
+	std::vector<Vec3f> vertices; //In the terrain's coordinates
+	std::vector<Vec3f> normals; //The terrain's normal at each vertex
+	std::vector<int> triangles; //The vertices of each triangle, three at a
+	                            //time, wound the same way as the grid strips
+};
+
+//Simplifies t by greedy insertion: starting from two triangles over its
+//corners, repeatedly adds the grid point furthest above or below the mesh,
+//keeping the mesh a Delaunay triangulation, until every height is within
+//maxError of the mesh.  Terrains may be up to 16384 cells across.
+TinMesh* simplifyTerrain(Terrain* t, float maxError);
+
+//Writes mesh to filename, as text
+void saveTin(const TinMesh* mesh, const char* filename);
+
+//Reads a mesh written by saveTin.  Returns NULL if the file isn't one.
+TinMesh* loadTin(const char* filename);
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,77 @@
+/* Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above notice and this permission notice shall be included in all copies
+ * or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+/* File for "Terrain" lesson of the OpenGL tutorial on
+ * www.videotutorialsrock.com
+ */
+
+
+
+#include <stdlib.h>
+
+#include <iostream>
+
+#include "heightmaps.h"
+#include "terrain.h"
+#include "tinmesh.h"
+
+using namespace std;
+
+//Simplifies a heightmap into a mesh for the game to draw in place of the grid:
+//
+//    tinsimplify heightmap.bmp heightmap.tin [maxError] [height]
+//
+//The heightmap may also be a .pgm or square .raw file.
+//
+//height scales the heightmap as the game does, and maxError is how far, in
+//the same units, the mesh may stray from any height.
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		cerr << "Usage: " << argv[0]
+			 << " heightmap.bmp out.tin [maxError] [height]" << endl;
+		return 1;
+	}
+	float maxError = argc > 3 ? (float)atof(argv[3]) : 0.1f;
+	float height = argc > 4 ? (float)atof(argv[4]) : 20.0f;
+
+	Terrain* terrain = loadHeightmap(argv[1], height);
+	if (terrain == NULL) {
+		cerr << "Not a heightmap: " << argv[1] << endl;
+		return 1;
+	}
+	TinMesh* mesh = simplifyTerrain(terrain, maxError);
+	saveTin(mesh, argv[2]);
+	cout << terrain->width() << " x " << terrain->length() << " heights, "
+		 << 2 * (terrain->width() - 1) * (terrain->length() - 1)
+		 << " grid triangles -> " << mesh->vertices.size() << " vertices, "
+		 << mesh->triangles.size() / 3 << " triangles" << endl;
+
+	delete mesh;
+	delete terrain;
+	return 0;
+}
+
+
+
+
+
+
+
+
+
+